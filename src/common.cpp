@@ -7,6 +7,16 @@ bool headlessMode;
 bool testMode;
 bool slowRendering;
 bool ignoreZBuffer;
+bool blockRasterisation;
+bool tiledRasterisation;
+bool pipelinedFrames;
+bool fixedPointRasterisation;
+bool depthPrepass;
+bool sortFrontToBack;
+bool sortTriangles;
+bool tiledTextures;
+int textureFilter;
+int perspectiveStep;
 bool nearestFilter;
 bool Do_VP_Clipping;
 
@@ -10,6 +10,7 @@
 #include <unordered_map>
 #include <cmath>
 #include <limits>
+#include <algorithm>
 #include <thread>
 
 #include <SDL2/SDL.h>
@@ -35,6 +36,16 @@ extern bool headlessMode;
 extern bool testMode;
 extern bool slowRendering;
 extern bool ignoreZBuffer;
+extern bool blockRasterisation;
+extern bool tiledRasterisation;
+extern bool pipelinedFrames;
+extern bool fixedPointRasterisation;
+extern bool depthPrepass;
+extern bool sortFrontToBack;
+extern bool sortTriangles;
+extern bool tiledTextures;
+extern int textureFilter; // 0 nearest, 1 nearest mipmapped, 2 bilinear mipmapped, 3 trilinear
+extern int perspectiveStep; // pixels between perspective correct texcoords, 0 corrects every pixel
 extern bool nearestFilter;
 extern bool Do_VP_Clipping;
 
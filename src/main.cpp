@@ -1,5 +1,6 @@
 #include "common.h"
 #include <tclap/CmdLine.h>
+#include <bit>
 #include "vmath-0.12/vmath.h"
 #include "window/window.h"
 #include "early_demos/starfield.h"
@@ -12,7 +13,7 @@
 
 //USAGE:
 //
-//   ./build/SDLsoftwarerenderer_linux64  [-z] [-s] [-t] [-l] [-v] [-i
+//   ./build/SDLsoftwarerenderer_linux64  [-z] [-b] [-x] [-e] [-o] [-q] [-m <Integer from 0 to 3>] [-a <Integer from 0 to 64>] [-u] [-g] [-f] [-s] [-t] [-l] [-v] [-i
 //                                        <Integer from 0 to 4>] [--]
 //                                        [--version] [-h]
 
@@ -224,12 +225,32 @@ void demo_rasteriser( Window *window )
     tris.verts[1].texVec = Vector2f { 0.5f,  0 }; // texels coords have to compensate for that.
     tris.verts[2].texVec = Vector2f {    1,  1 };
 
+    // floor below the scene. Its texcoords go way beyond 0 to 1, so the texture repeats.
+    auto floorTexture = make_shared<Texture>( "examples/tree.bmp" );
+    floorTexture->SetWrapMode( Texture::wrap_repeat );
+    Matrix4f objMatrix_floor = Matrix4f::createTranslation( 0, -3, 0 );
+    Triangle floorTris[ 2 ];
+    floorTris[0].verts[0].posVec = Vector4f { -40, 0,  0, 1 };
+    floorTris[0].verts[1].posVec = Vector4f { -40, 0, 40, 1 };
+    floorTris[0].verts[2].posVec = Vector4f {  40, 0, 40, 1 };
+    floorTris[1].verts[0].posVec = Vector4f { -40, 0,  0, 1 };
+    floorTris[1].verts[1].posVec = Vector4f {  40, 0, 40, 1 };
+    floorTris[1].verts[2].posVec = Vector4f {  40, 0,  0, 1 };
+    for ( Triangle& floorTri : floorTris )
+    {
+        for ( Vertexf& vert : floorTri.verts )
+        {
+            vert.texVec = Vector2f { vert.posVec.x / 4, vert.posVec.z / 4 }; // one copy every 4 units
+        }
+    }
+
     bool running = true;
     while ( running )
     {
         running = !checkQuit();
 
-        window->clearBuffers();
+        // rasterisers cover every pixel of the window
+        window->clearBuffers( false );
         render->ClearBuffers();
 
         render->InitiateRendering();
@@ -252,6 +273,12 @@ void demo_rasteriser( Window *window )
             cout << "v1 - x: " << tris.verts[0].posVec.x << " y: " << tris.verts[0].posVec.y << " z: " << tris.verts[0].posVec.z << endl;
         }
 
+        // draw floor
+        render->SetDrawTexture( floorTexture );
+        render->SetObjectToWorldMatrix( objMatrix_floor );
+        render->FillTriangle( floorTris[0] );
+        render->FillTriangle( floorTris[1] );
+
         // draw triangle
         render->SetDrawTexture( bmpTexture );
         render->SetObjectToWorldMatrix( objMatrix_triangle );
@@ -262,8 +289,9 @@ void demo_rasteriser( Window *window )
         render->DrawMesh( objMatrix_mesh, sphereModel, triangleColor);
         render->DrawMesh( objMatrix_mesh, chaletModel, chaletTexture );
 
-        render->WaitUntilFinished();
-        window->updateWindow();
+        // the first frame with pipelinedFrames isn't drawn yet
+        if ( render->WaitUntilFinished() )
+            window->updateWindow();
         if ( printDebug ) [[unlikely]]
         {
             window->timer.printTimes();
@@ -322,6 +350,16 @@ int main( int argc, char* argv[] )
         TCLAP::SwitchArg testing( "t", "test-mode", "Automatically stops program execution some time", cmd, false );
         TCLAP::SwitchArg slowRender( "c", "slow-rendering", "(demo 3 only!) Update window each time a triangle line was drawn", cmd, false );
         TCLAP::SwitchArg ignoreZ( "z", "ignoreZ", "(demo 3 only!) Ignore Z value stored in Z-buffer during fragment depth test", cmd, false );
+        TCLAP::SwitchArg blockRaster( "b", "block-raster", "(demo 3 only!) Rasterise triangles by testing 8x8 pixel blocks against their edge functions instead of walking scanlines", cmd, false );
+        TCLAP::SwitchArg fixedPoint( "x", "fixed-point", "(demo 3 only!) Snap triangles to 28.4 fixed point and walk their edges with integers in the scanline rasteriser", cmd, false );
+        TCLAP::SwitchArg prepass( "e", "depth-prepass", "(demo 3 only!) Fill the z-buffer in a first pass and only texture visible pixels in a second one", cmd, false );
+        TCLAP::SwitchArg frontToBack( "o", "front-to-back", "(demo 3 only!) Sort draws by their distance to the camera so that near objects are drawn first", cmd, false );
+        TCLAP::SwitchArg sortTris( "q", "sort-triangles", "(demo 3 only!) Roughly sort triangles of each mesh by their distance to the camera", cmd, false );
+        TCLAP::ValueArg< int > texFilter( "m", "texture-filter", "(demo 3 only!) Texture filter. 0 is nearest, 1 nearest with mipmaps, 2 bilinear with mipmaps and 3 trilinear", false, 0, "Integer from 0 to 3", cmd );
+        TCLAP::ValueArg< int > perspStep( "a", "affine-step", "(demo 3 only!) Only divide texcoords by depth every this many pixels and interpolate them linearly in between. Rounded down to a power of two, 0 divides for every pixel", false, 0, "Integer from 0 to 64", cmd );
+        TCLAP::SwitchArg tiledTex( "u", "tiled-textures", "(demo 3 only!) Store textures in 4x4 pixel tiles instead of rows so that texels close to each other share cache lines", cmd, false );
+        TCLAP::SwitchArg tiledRaster( "g", "tiled-raster", "(demo 3 only!) Split screen into 64x64 pixel tiles that rasteriser threads take turns on instead of fixed horizontal bands", cmd, false );
+        TCLAP::SwitchArg pipelined( "f", "pipelined-frames", "(demo 3 only!) Keep two frames in flight. Vertex processors work on the next frame while rasterisers still draw the current one, which adds a frame of latency", cmd, false );
         TCLAP::ValueArg< int > framerate( "r", "framerate-limit", "Set a maximum framerate limit", false, 60, "Frames per Second", cmd );
         TCLAP::ValueArg< int > width( "w", "width", "Set the initial window width", false, 1024, "Horizontal Pixel count", cmd);
         TCLAP::ValueArg< int > height( "v", "vertical", "Set the initial window vertical height", false, 768, "Vertical Pixel count", cmd);
@@ -334,6 +372,16 @@ int main( int argc, char* argv[] )
         testMode = testing.getValue();
         slowRendering = slowRender.getValue();
         ignoreZBuffer = ignoreZ.getValue();
+        blockRasterisation = blockRaster.getValue();
+        tiledRasterisation = tiledRaster.getValue();
+        pipelinedFrames = pipelined.getValue();
+        fixedPointRasterisation = fixedPoint.getValue();
+        depthPrepass = prepass.getValue();
+        sortFrontToBack = frontToBack.getValue();
+        sortTriangles = sortTris.getValue();
+        textureFilter = clipNumber( texFilter.getValue(), 0, 3 );
+        perspectiveStep = std::bit_floor( (unsigned) clipNumber( perspStep.getValue(), 0, 64 ) ); // runs are aligned with masks
+        tiledTextures = tiledTex.getValue();
         nearestFilter = nearestFiltering.getValue();
         int fps = framerate.getValue();
         int wwidth = width.getValue();
@@ -1,57 +1,195 @@
 #include "rasteriser.h"
 
-Rasteriser::Rasteriser( shared_ptr< SafeDeque< VPOO > > in, const Uint16& frame_width, const Uint16& frame_height , const Uint16& y_begin, const Uint16& y_end )
+#if defined( __SSE4_1__ ) || defined( __AVX2__ )
+    #include <immintrin.h>
+#endif
+
+Rasteriser::Rasteriser( shared_ptr< AppendLog< VPOO > > in, const Uint16& frame_width, const Uint16& frame_height,
+                        const Uint16& x_begin, const Uint16& x_end, const Uint16& y_begin, const Uint16& y_end )
 {
     //ctor
     this->in_vpoos = in;
-    this->y_begin = y_begin;
-    this->y_end   = y_end;
     this->frame_width = frame_width;
     this->frame_height = frame_height;
-    this->r_texture = make_shared< Texture >(frame_width, y_end - y_begin);
+    this->r_texture = make_shared< Texture >( 0, 0 );
+
+    SetArea( x_begin, x_end, y_begin, y_end );
+}
+
+void Rasteriser::SetArea( const Uint16& x_begin, const Uint16& x_end, const Uint16& y_begin, const Uint16& y_end )
+{
+    this->x_begin = x_begin;
+    this->x_end   = x_end;
+    this->y_begin = y_begin;
+    this->y_end   = y_end;
 
-    // init z_buffer
-    size_t zsize = r_texture->GetWidth() * r_texture->GetHeight();
-    z_buffer.resize( zsize );
-    z_buffer.shrink_to_fit();
+    // buffers only get reallocated if they have to grow
+    r_texture->Resize( x_end - x_begin, y_end - y_begin );
+    z_buffer.resize( r_texture->GetWidth() * r_texture->GetHeight() );
+    SetColourTarget( r_texture->t_pixels.data(), r_texture->GetWidth() );
+
+    // hierarchical z buffer. tiles are aligned to the screen so the outer
+    // tiles may only partially belong to us.
+    hiz_width  = ( x_end > x_begin ) ? ( x_end - 1 ) / block_size - x_begin / block_size + 1 : 0;
+    hiz_height = ( y_end > y_begin ) ? ( y_end - 1 ) / block_size - y_begin / block_size + 1 : 0;
+    hiz_buffer.resize( hiz_width * hiz_height );
+    hiz_state.resize( hiz_width * hiz_height );
+    tile_clear_pending.resize( hiz_width * hiz_height );
 }
 
 void Rasteriser::initFramebuffer()
 {
-    // clearing
-    std::fill( z_buffer.begin(), z_buffer.end(), std::numeric_limits< float >::max() );
-    //r_texture->clear();
-    r_texture->FillWithRandomColour();
+    // clearing. z_buffer and r_texture are only cleared where they get drawn to (see ClearTile).
+    // Colour is random like Texture::FillWithRandomColour to show which parts belong to whom.
+    std::fill( hiz_buffer.begin(), hiz_buffer.end(), std::numeric_limits< float >::max() );
+    std::fill( hiz_state.begin(), hiz_state.end(), hiz_valid );
+    std::fill( tile_clear_pending.begin(), tile_clear_pending.end(), true );
+    hiz_touched_tiles.clear();
+    clear_pixel = ( SDL_ALPHA_OPAQUE << 24 ) | rand() % 16777216;
 }
 
 void Rasteriser::finaliseFrame()
 {
-    // TODO
+    // tiles nobody drew to still need their colour. Their depth is never read.
+    for ( Uint32 hiz_index = 0; hiz_index < tile_clear_pending.size(); hiz_index++ )
+    {
+        if ( tile_clear_pending[ hiz_index ] )
+            ClearTile( hiz_index, false );
+    }
 }
 
 void Rasteriser::ProcessVPOOArray()
 {
+    // busy time leaves out waiting for new VPOOs, so it only depends on how much there is to draw
+    auto busy_start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration busy_time = std::chrono::steady_clock::duration::zero();
+
     initFramebuffer();
+    busy_time += std::chrono::steady_clock::now() - busy_start;
 
-    for ( int i = 0; !in_vpoos->isLastBlocked( i ); i++ )
+    if ( depthPrepass && !ignoreZBuffer )
     {
-        current_vpoo = in_vpoos->at(i);
-        ProcessCurrentVPOO();
+        // the first pass waits for all VPOOs to arrive, the second one goes over them again
+        current_pass = pass_depth;
+        ProcessAllVPOOs( busy_time );
+        current_pass = pass_shade;
+        ProcessAllVPOOs( busy_time );
+    }
+    else
+    {
+        current_pass = pass_all;
+        ProcessAllVPOOs( busy_time );
     }
 
     finaliseFrame();
+
+    busy_time_ns = std::chrono::duration_cast< std::chrono::nanoseconds >( busy_time ).count();
+}
+
+void Rasteriser::ProcessAllVPOOs( std::chrono::steady_clock::duration& busy_time )
+{
+    auto cursor = in_vpoos->begin();
+    while ( const VPOO* vpoo = in_vpoos->next( cursor ) )
+    {
+        auto busy_start = std::chrono::steady_clock::now();
+        current_vpoo = *vpoo;
+        ProcessCurrentVPOO();
+        busy_time += std::chrono::steady_clock::now() - busy_start;
+    }
+}
+
+bool Rasteriser::IsTileOccluded( Uint32 hiz_index, float min_depth )
+{
+    // true if min_depth is behind every pixel of the tile
+    if ( min_depth > hiz_buffer[ hiz_index ] )
+        return true;
+
+    if ( hiz_state[ hiz_index ] != hiz_stale )
+        return false;
+
+    RefreshHiZ( hiz_index );
+    return min_depth > hiz_buffer[ hiz_index ];
+}
+
+void Rasteriser::GetHiZTileArea( Uint32 hiz_index, int& x_start, int& y_start, int& x_stop, int& y_stop ) const
+{
+    // pixels of a tile that belong to our area
+    x_start = ( hiz_index % hiz_width + x_begin / block_size ) * block_size;
+    y_start = ( hiz_index / hiz_width + y_begin / block_size ) * block_size;
+    x_stop = std::min( x_start + block_size, (int) x_end );
+    y_stop = std::min( y_start + block_size, (int) y_end );
+    x_start = std::max( x_start, (int) x_begin );
+    y_start = std::max( y_start, (int) y_begin );
+}
+
+void Rasteriser::ClearTile( Uint32 hiz_index, bool clear_depth )
+{
+    int x_start, y_start, x_stop, y_stop;
+    GetHiZTileArea( hiz_index, x_start, y_start, x_stop, y_stop );
+
+    for ( int y = y_start; y < y_stop; y++ )
+    {
+        Uint32* colour_row = colour_pixels + ( y - y_begin ) * colour_pitch;
+        std::fill( colour_row + x_start - x_begin, colour_row + x_stop - x_begin, clear_pixel );
+        if ( clear_depth )
+        {
+            float* z_row = z_buffer.data() + ( y - y_begin ) * r_texture->GetWidth();
+            std::fill( z_row + x_start - x_begin, z_row + x_stop - x_begin, std::numeric_limits< float >::max() );
+        }
+    }
+    tile_clear_pending[ hiz_index ] = false;
 }
 
-inline float Rasteriser::GetZ( const Uint32& index ) const
+inline void Rasteriser::ClearPendingTiles( int x_first, int x_last, int y )
 {
-    return z_buffer.at(index);
+    // clears tiles of pixels x_first to x_last (exclusive) in row y that nobody drew to yet
+    Uint32 hiz_last = GetHiZIndex( x_last - 1, y );
+    for ( Uint32 hiz_index = GetHiZIndex( x_first, y ); hiz_index <= hiz_last; hiz_index++ )
+    {
+        if ( tile_clear_pending[ hiz_index ] ) [[unlikely]]
+            ClearTile( hiz_index, true );
+    }
 }
 
-inline void Rasteriser::SetZ( const Uint32& index, const float& z_value )
+void Rasteriser::RefreshHiZ( Uint32 hiz_index )
 {
-    z_buffer.at(index) = z_value;
+    // recalculates farthest depth of tile from z_buffer
+    int x_start, y_start, x_stop, y_stop;
+    GetHiZTileArea( hiz_index, x_start, y_start, x_stop, y_stop );
+
+    float max_depth = std::numeric_limits< float >::lowest();
+    for ( int y = y_start; y < y_stop; y++ )
+    {
+        const float* z_row = z_buffer.data() + ( y - y_begin ) * r_texture->GetWidth();
+        for ( int x = x_start; x < x_stop; x++ )
+        {
+            max_depth = std::max( max_depth, z_row[ x - x_begin ] );
+        }
+    }
+
+    hiz_buffer[ hiz_index ] = max_depth;
+    hiz_state[ hiz_index ] = hiz_valid;
 }
 
+void Rasteriser::TouchHiZ( Uint32 hiz_index )
+{
+    // remember tile for MarkTouchedHiZStale. A triangle can't occlude itself so
+    // there is no point in refreshing the tile before the triangle is done.
+    if ( hiz_state[ hiz_index ] != hiz_touched )
+    {
+        hiz_state[ hiz_index ] = hiz_touched;
+        hiz_touched_tiles.push_back( hiz_index );
+    }
+}
+
+void Rasteriser::MarkTouchedHiZStale()
+{
+    for ( Uint32 hiz_index : hiz_touched_tiles )
+    {
+        hiz_state[ hiz_index ] = hiz_stale;
+    }
+    hiz_touched_tiles.clear();
+}
 
 void Rasteriser::ProcessCurrentVPOO()
 {
@@ -59,14 +197,141 @@ void Rasteriser::ProcessCurrentVPOO()
     const Vertexf& vertMid = current_vpoo.tris_verts[1];
     const Vertexf& vertMax = current_vpoo.tris_verts[2];
 
-    // create texcoords and edges
-    TexCoordsForEdgef texcoords = TexCoordsForEdgef( vertMin, vertMid, vertMax );
-    Edgef topToBottom    = Edgef( vertMin, vertMax, texcoords, 0 );
-    Edgef topToMiddle    = Edgef( vertMin, vertMid, texcoords, 0 );
-    Edgef middleToBottom = Edgef( vertMid, vertMax, texcoords, 1 );
+    // setup was done by the vertex processor, edges are copied so they can be stepped
+    const TexCoordsForEdgef& texcoords = current_vpoo.setup.texcoords;
 
-    ScanEdges( topToBottom, topToMiddle, current_vpoo.isRightHanded );
-    ScanEdges( topToBottom, middleToBottom, current_vpoo.isRightHanded );
+    SetupPipeline( texcoords );
+
+    if ( blockRasterisation )
+    {
+        RasteriseBlocks( vertMin, vertMid, vertMax, texcoords );
+    }
+    else if ( fixedPointRasterisation && ScanTriangleFixed( vertMin, vertMid, vertMax, texcoords ) )
+    {
+        // done
+    }
+    else if ( current_vpoo.isSmall )
+    {
+        ScanSmallTriangle( vertMin, vertMid, vertMax, texcoords, current_vpoo.isRightHanded );
+    }
+    else
+    {
+        Edgef topToBottom    = current_vpoo.setup.topToBottom;
+        Edgef topToMiddle    = current_vpoo.setup.topToMiddle;
+        Edgef middleToBottom = current_vpoo.setup.middleToBottom;
+
+        ScanEdges( topToBottom, topToMiddle, current_vpoo.isRightHanded );
+        ScanEdges( topToBottom, middleToBottom, current_vpoo.isRightHanded );
+    }
+
+    MarkTouchedHiZStale();
+}
+
+bool Rasteriser::ScanTriangleFixed( const Vertexf& vertMin, const Vertexf& vertMid, const Vertexf& vertMax, const TexCoordsForEdgef& texcoords )
+{
+    // Scans triangle with edges in 28.4 fixed point. Coverage is decided with integers only,
+    // interpolants are evaluated from their plane equations for each span.
+    // Returns false if the triangle is too big for fixed point (without vp clipping).
+    const float max_coordinate = 1 << 23;
+    for ( const Vertexf* vert : { &vertMin, &vertMid, &vertMax } )
+    {
+        if ( !( abs( vert->posVec.x ) < max_coordinate && abs( vert->posVec.y ) < max_coordinate ) )
+            return false;
+    }
+
+    Sint64 minX = FixedEdge::ToFixed( vertMin.posVec.x ), minY = FixedEdge::ToFixed( vertMin.posVec.y );
+    Sint64 midX = FixedEdge::ToFixed( vertMid.posVec.x ), midY = FixedEdge::ToFixed( vertMid.posVec.y );
+    Sint64 maxX = FixedEdge::ToFixed( vertMax.posVec.x ), maxY = FixedEdge::ToFixed( vertMax.posVec.y );
+
+    // the long edge is left of the middle vertex if their cross product is negative. triangles
+    // that collapsed into a line when snapping do not cover any pixels.
+    Sint64 cross = ( maxX - minX ) * ( midY - minY ) - ( maxY - minY ) * ( midX - minX );
+    if ( cross == 0 )
+        return true;
+
+    FixedEdge longEdge   = FixedEdge( minX, minY, maxX, maxY );
+    FixedEdge topEdge    = FixedEdge( minX, minY, midX, midY );
+    FixedEdge bottomEdge = FixedEdge( midX, midY, maxX, maxY );
+
+    ScanEdgesFixed( longEdge, topEdge,    cross < 0, vertMin, texcoords );
+    ScanEdgesFixed( longEdge, bottomEdge, cross < 0, vertMin, texcoords );
+    return true;
+}
+
+void Rasteriser::ScanEdgesFixed( FixedEdge& longEdge, FixedEdge& shortEdge, bool longEdgeIsLeft, const Vertexf& vertMin, const TexCoordsForEdgef& texcoords )
+{
+    // edges are exact so both can jump straight to the first row inside of our area
+    int y_start = std::max( shortEdge.yStart, (int) y_begin );
+    int y_stop  = std::min( shortEdge.yEnd,   (int) y_end );
+    if ( y_start >= y_stop )
+        return;
+
+    longEdge.GoToY( y_start );
+    shortEdge.GoToY( y_start );
+    const FixedEdge& left  = longEdgeIsLeft ? longEdge : shortEdge;
+    const FixedEdge& right = longEdgeIsLeft ? shortEdge : longEdge;
+
+    for ( int y = y_start; y < y_stop; y++ )
+    {
+        if ( left.currentX < right.currentX )
+            DrawSpan( GetPlaneSpan( vertMin, texcoords, left.currentX, right.currentX, y ) );
+
+        longEdge.DoYStep();
+        shortEdge.DoYStep();
+    }
+}
+
+struct ScanlineX
+{
+    // x at which a triangle edge crosses each scanline. Set up and stepped exactly
+    // like Edge does, but without attributes.
+    float currentX = 0, xStep = 0;
+    int yStart = 0, yEnd = 0;
+
+    ScanlineX( const Vector4f& posMin, const Vector4f& posMax )
+    {
+        yStart = std::ceil( posMin.y );
+        yEnd   = std::ceil( posMax.y );
+
+        float yDist = posMax.y - posMin.y;
+        if ( yDist == 0 )
+            return;
+
+        float yPrestep = (float) yStart - posMin.y;
+        xStep = ( posMax.x - posMin.x ) / yDist;
+        currentX = posMin.x + yPrestep * xStep + xStep * std::max( -yStart, 0 );
+        yStart = std::max( yStart, 0 );
+    }
+};
+
+void Rasteriser::ScanSmallTriangle( const Vertexf& vertMin, const Vertexf& vertMid, const Vertexf& vertMax, const TexCoordsForEdgef& texcoords, bool isRightHanded )
+{
+    // Scans triangles that only cover a few pixels. Same coverage as ScanEdges, so
+    // they fit seamlessly to their neighbours, but only x is walked along the edges.
+    // Interpolants come from their plane equations, which saves setting up and
+    // stepping the attributes of three edges for a handful of pixels.
+    ScanlineX topToBottom    = ScanlineX( vertMin.posVec, vertMax.posVec );
+    ScanlineX topToMiddle    = ScanlineX( vertMin.posVec, vertMid.posVec );
+    ScanlineX middleToBottom = ScanlineX( vertMid.posVec, vertMax.posVec );
+
+    for ( ScanlineX* shortEdge : { &topToMiddle, &middleToBottom } )
+    {
+        bool leftEdgeIsShort = isRightHanded || shortEdge->currentX < topToBottom.currentX;
+        const ScanlineX& left  = leftEdgeIsShort ? *shortEdge : topToBottom;
+        const ScanlineX& right = leftEdgeIsShort ? topToBottom : *shortEdge;
+
+        int y_stop = std::min( shortEdge->yEnd, (int) y_end );
+        for ( int y = shortEdge->yStart; y < y_stop; y++ )
+        {
+            int xMin = std::ceil( left.currentX );
+            int xMax = std::ceil( right.currentX );
+            if ( y >= y_begin && std::min( xMax, (int) x_end ) > std::max( xMin, (int) x_begin ) )
+                DrawSpan( GetPlaneSpan( vertMin, texcoords, xMin, xMax, y ) );
+
+            topToBottom.currentX += topToBottom.xStep;
+            shortEdge->currentX  += shortEdge->xStep;
+        }
+    }
 }
 
 void Rasteriser::ScanEdges( Edgef& a, Edgef& b, bool isRightHanded )
@@ -98,6 +363,10 @@ void Rasteriser::DrawScanLine( const Edgef& left, const Edgef& right, Uint16 yCo
     int xMin = std::ceil( left.GetCurrentX() );
     int xMax = std::ceil( right.GetCurrentX() );
 
+    // stop here if no pixel of the line is inside of our area
+    if ( std::min( xMax, (int) x_end ) <= std::max( xMin, (int) x_begin ) )
+        return;
+
     // draw line while taking into account our texels and texture
     // texels have to be interpolated along the x-axis
 
@@ -111,92 +380,661 @@ void Rasteriser::DrawScanLine( const Edgef& left, const Edgef& right, Uint16 yCo
         return;
     }
 
-    // now calculate xx, yx and zx steps
-    float texCoordXX_step = ( right.GetCurrentTexCoordX() - left.GetCurrentTexCoordX() ) / xDist;
-    float texCoordYX_step = ( right.GetCurrentTexCoordY() - left.GetCurrentTexCoordY() ) / xDist;
-    float oneOverZX_step  = ( right.GetCurrentOneOverZ()  - left.GetCurrentOneOverZ()  ) / xDist;
-    float depthX_step = ( right.GetCurrentDepth() - left.GetCurrentDepth() ) / xDist;
+    // pixels outside of our area are clipped by DrawSpan
+    Spanf span;
+    span.y = yCoord;
+    span.x_begin = xMin;
+    span.x_end   = xMax;
+    for ( Uint8 attribute = 0; attribute < attribute_count; attribute++ )
+    {
+        // now calculate x steps of attributes and find the values we want to iterate over
+        span.steps[attribute]  = ( right.GetCurrent( attribute ) - left.GetCurrent( attribute ) ) / xDist;
+        span.values[attribute] = left.GetCurrent( attribute ) + span.steps[attribute] * xPrestep;
+    }
+
+    DrawSpan( span );
+}
+
+void Rasteriser::RasteriseBlocks( const Vertexf& vertMin, const Vertexf& vertMid, const Vertexf& vertMax, const TexCoordsForEdgef& texcoords )
+{
+    // Half-space rasterisation. Instead of walking edges we test pixels against all
+    // three edge functions. Tiles and blocks that lie completely outside of one
+    // edge are rejected before any pixel is looked at. Those that lie completely
+    // inside of all edges are filled without looking at edges at all.
+
+    // wind edges so that the inside of the triangle is positive
+    const Vertexf& vertB = current_vpoo.isRightHanded ? vertMax : vertMid;
+    const Vertexf& vertC = current_vpoo.isRightHanded ? vertMid : vertMax;
+    const EdgeFunctionf edges[3] = { EdgeFunctionf( vertMin.posVec, vertB.posVec ),
+                                     EdgeFunctionf( vertB.posVec,   vertC.posVec ),
+                                     EdgeFunctionf( vertC.posVec,   vertMin.posVec ) };
+
+    // bounding box of triangle clipped against our part of the screen
+    float xLow  = std::min( { vertMin.posVec.x, vertMid.posVec.x, vertMax.posVec.x } );
+    float xHigh = std::max( { vertMin.posVec.x, vertMid.posVec.x, vertMax.posVec.x } );
+    int x_start = std::max( (int) std::ceil( xLow ), (int) x_begin );
+    int x_stop  = std::min( (int) std::ceil( xHigh ), (int) x_end );
+    int y_start = std::max( (int) std::ceil( vertMin.posVec.y ), (int) y_begin );
+    int y_stop  = std::min( (int) std::ceil( vertMax.posVec.y ), (int) y_end );
+
+    if ( x_start >= x_stop || y_start >= y_stop )
+        return;
+
+    // tiles are aligned to the screen so that they stay the same between triangles
+    for ( int tileY = y_start - y_start % tile_size; tileY < y_stop; tileY += tile_size )
+    {
+        for ( int tileX = x_start - x_start % tile_size; tileX < x_stop; tileX += tile_size )
+        {
+            bool tileOutside = false;
+            bool tileInside = true;
+            for ( const auto& edge : edges )
+            {
+                tileOutside |= edge.GetBlockMax( tileX, tileY, tile_size ) < 0;
+                tileInside  &= edge.IsBlockInside( tileX, tileY, tile_size, trivial_accept_margin );
+            }
+            if ( tileOutside )
+                continue;
+
+            int tileX_stop = std::min( tileX + tile_size, x_stop );
+            int tileY_stop = std::min( tileY + tile_size, y_stop );
+            if ( tileInside )
+            {
+                // whole rows of the tile are covered. occluded parts are skipped by DrawSpan.
+                for ( int y = std::max( tileY, y_start ); y < tileY_stop; y++ )
+                {
+                    DrawSpan( GetPlaneSpan( vertMin, texcoords, std::max( tileX, x_start ), tileX_stop, y ) );
+                }
+                continue;
+            }
+
+            for ( int blockY = std::max( tileY, y_start - y_start % block_size ); blockY < tileY_stop; blockY += block_size )
+            {
+                for ( int blockX = std::max( tileX, x_start - x_start % block_size ); blockX < tileX_stop; blockX += block_size )
+                {
+                    RasteriseBlock( edges, vertMin, texcoords,
+                                    std::max( blockX, x_start ), std::max( blockY, y_start ),
+                                    std::min( blockX + block_size, tileX_stop ), std::min( blockY + block_size, tileY_stop ) );
+                }
+            }
+        }
+    }
+}
 
-    // then find the texcoords we want to iterate over
-    float current_texCoordX = left.GetCurrentTexCoordX() + texCoordXX_step * xPrestep;
-    float current_texCoordY = left.GetCurrentTexCoordY() + texCoordYX_step * xPrestep;
-    float current_oneOverZ  = left.GetCurrentOneOverZ()  + oneOverZX_step  * xPrestep;
-    float current_depth = left.GetCurrentDepth() + depthX_step * xPrestep;
+void Rasteriser::RasteriseBlock( const EdgeFunctionf (&edges)[3], const Vertexf& vertMin, const TexCoordsForEdgef& texcoords,
+                                 int x_start, int y_start, int x_stop, int y_stop )
+{
+    // reject block if it is outside of any edge
+    bool blockInside = true;
+    for ( const auto& edge : edges )
+    {
+        if ( edge.GetBlockMax( x_start, y_start, block_size ) < 0 )
+            return;
+        blockInside &= edge.IsBlockInside( x_start, y_start, block_size, trivial_accept_margin );
+    }
 
-    // if xMin smaller than 0, add steps that are outside of screen area
-    if ( xMin < 0 )
+    // reject block if the triangle is behind everything drawn to it so far.
+    // Depth is linear so its minimum is found at one of the corners. The margin covers
+    // rounding differences to the per span evaluation done by the fragment kernels.
+    if ( !ignoreZBuffer )
     {
-        int distance = abs( 0 - xMin );
-        current_texCoordX += texCoordXX_step * distance;
-        current_texCoordY += texCoordYX_step * distance;
-        current_oneOverZ  += oneOverZX_step  * distance;
-        current_depth     += depthX_step     * distance;
+        float depth_x0 = texcoords.GetValue( attribute_depth, 0 ) + texcoords.GetXStep( attribute_depth ) * ( x_start - vertMin.posVec.x );
+        float depth_x1 = texcoords.GetValue( attribute_depth, 0 ) + texcoords.GetXStep( attribute_depth ) * ( x_stop - 1 - vertMin.posVec.x );
+        float depth_y0 = texcoords.GetYStep( attribute_depth ) * ( y_start - vertMin.posVec.y );
+        float depth_y1 = texcoords.GetYStep( attribute_depth ) * ( y_stop - 1 - vertMin.posVec.y );
+        float min_depth = std::min( depth_x0, depth_x1 ) + std::min( depth_y0, depth_y1 );
+        min_depth -= 1e-5f * ( 1.0f + std::abs( min_depth ) );
 
-        xMin = 0;
+        if ( IsTileOccluded( GetHiZIndex( x_start, y_start ), min_depth ) )
+            return;
     }
 
-    // loop through each x and draw pixel, clip ensures that pixels outside of screen are not iterated over
-    for ( int x = clipNumber( xMin , 0, (int) r_texture->GetWidth() ); x < clipNumber( xMax , xMin, (int) r_texture->GetWidth() ); x++ )
+    if ( blockInside )
     {
-        if ( current_vpoo.texture != nullptr )
+        for ( int y = y_start; y < y_stop; y++ )
         {
-            float z = 1.0f / current_oneOverZ;
+            DrawSpan( GetPlaneSpan( vertMin, texcoords, x_start, x_stop, y ) );
+        }
+        return;
+    }
 
-            // calculate texture coords
-            Uint16 textureX = clipNumber< Uint16 >( std::ceil((current_texCoordX * z) * (current_vpoo.texture->GetWidth()  - 1) + 0.5f ),
-                                                                                      0, current_vpoo.texture->GetWidth()  - 1  + 0.5f );
-            Uint16 textureY = clipNumber< Uint16 >( std::ceil((current_texCoordY * z) * (current_vpoo.texture->GetHeight() - 1) + 0.5f ),
-                                                                                      0, current_vpoo.texture->GetHeight() - 1  + 0.5f );
+    for ( int y = y_start; y < y_stop; y++ )
+    {
+        // find covered pixels in this row. triangles are convex so they form a single span.
+        float values[3] = { edges[0].Evaluate( x_start, y ), edges[1].Evaluate( x_start, y ), edges[2].Evaluate( x_start, y ) };
+        int xFirst = x_stop, xLast = x_start - 1;
+        for ( int x = x_start; x < x_stop; x++ )
+        {
+            if ( edges[0].IsInside( values[0] ) && edges[1].IsInside( values[1] ) && edges[2].IsInside( values[2] ) )
+            {
+                xFirst = std::min( xFirst, x );
+                xLast  = x;
+            }
+            values[0] += edges[0].xStep;
+            values[1] += edges[1].xStep;
+            values[2] += edges[2].xStep;
+        }
+        if ( xFirst > xLast )
+            continue;
+
+        DrawSpan( GetPlaneSpan( vertMin, texcoords, xFirst, xLast + 1, y ) );
+    }
+}
+
+Spanf Rasteriser::GetPlaneSpan( const Vertexf& vertMin, const TexCoordsForEdgef& texcoords, int x_begin, int x_end, int y ) const
+{
+    // evaluates the plane equations of our interpolants at the first pixel of a span
+    float xDist = x_begin - vertMin.posVec.x;
+    float yDist = y - vertMin.posVec.y;
+
+    Spanf span;
+    span.y = y;
+    span.x_begin = x_begin;
+    span.x_end   = x_end;
+    for ( Uint8 attribute = 0; attribute < attribute_count; attribute++ )
+    {
+        span.values[attribute] = texcoords.GetValue( attribute, 0 ) + texcoords.GetXStep( attribute ) * xDist + texcoords.GetYStep( attribute ) * yDist;
+        span.steps[attribute]  = texcoords.GetXStep( attribute );
+    }
 
-            DrawFragment( x, yCoord - y_begin, current_depth, textureX, textureY );
+    return span;
+}
+
+// every possible pipeline state gets its own specialisation of DrawPipelineSpan
+const std::array< Rasteriser::DrawSpanFunction, Rasteriser::pipeline_state_count > Rasteriser::draw_span_functions =
+    Rasteriser::GetDrawSpanFunctions( std::make_index_sequence< Rasteriser::pipeline_state_count >() );
+
+void Rasteriser::SetupPipeline( const TexCoordsForEdgef& texcoords )
+{
+    // picks pipeline state and resolves everything that stays the same for the whole triangle
+    Uint16 state = pipeline_colour_write;
+    if ( current_vpoo.texture != nullptr )
+    {
+        state |= pipeline_textured;
+        state |= current_vpoo.texture->GetWrapMode() << pipeline_wrap_shift;
+        if ( current_vpoo.texture->IsTiled() )
+            state |= pipeline_tiled_texture;
+        if ( current_vpoo.texture->IsPowerOfTwo() )
+            state |= pipeline_pow2_texture;
+        if ( textureFilter == 1 )
+            state |= pipeline_filter_mipmapped;
+        else if ( textureFilter == 2 )
+            state |= pipeline_filter_bilinear;
+        else if ( textureFilter == 3 )
+            state |= pipeline_filter_trilinear;
+        if ( perspectiveStep > 1 )
+            state |= pipeline_affine_runs;
+
+        const Texture* texture = current_vpoo.texture;
+        triangle_context.texture = texture;
+        triangle_context.level = TextureLevel( *texture, 0 );
+        triangle_context.texCoordX_YStep = texcoords.GetYStep( attribute_texCoordX );
+        triangle_context.texCoordY_YStep = texcoords.GetYStep( attribute_texCoordY );
+        triangle_context.oneOverZ_YStep  = texcoords.GetYStep( attribute_oneOverZ );
+    }
+    else
+    {
+        triangle_context.texture = nullptr;
+        triangle_context.colour = getPixelFor_SDLColor( &current_vpoo.colour );
+    }
+
+    if ( !ignoreZBuffer )
+    {
+        if ( current_pass == pass_depth )
+            state = pipeline_depth_test | pipeline_depth_write; // only fill z buffer
+        else if ( current_pass == pass_shade )
+            state |= pipeline_depth_test | pipeline_depth_equal; // z buffer is already filled
+        else
+            state |= pipeline_depth_test | pipeline_depth_write;
+    }
+
+    draw_span = draw_span_functions[ state ];
+    assert( draw_span != nullptr );
+}
+
+void Rasteriser::SelectMipLevels( SpanContext& context, const Spanf& span, bool blend_levels ) const
+{
+    // Picks mip levels from the texcoord derivatives in the middle of the span. The span is
+    // not clipped to our area yet, so the level does not depend on how the screen is split up.
+    float i = 0.5f * (float) ( span.x_end - 1 - span.x_begin );
+    float z = 1.0f / span.Get( attribute_oneOverZ, i );
+    float u = span.Get( attribute_texCoordX, i ) * z;
+    float v = span.Get( attribute_texCoordY, i ) * z;
+
+    // derivative of texCoord / oneOverZ, in texels of level 0
+    float width  = context.texture->GetWidth();
+    float height = context.texture->GetHeight();
+    float dudx = ( span.steps[attribute_texCoordX] - u * span.steps[attribute_oneOverZ] ) * z * width;
+    float dvdx = ( span.steps[attribute_texCoordY] - v * span.steps[attribute_oneOverZ] ) * z * height;
+    float dudy = ( context.texCoordX_YStep - u * context.oneOverZ_YStep ) * z * width;
+    float dvdy = ( context.texCoordY_YStep - v * context.oneOverZ_YStep ) * z * height;
+    float rho_squared = std::max( dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy );
+
+    // log2 of rho. catches magnification, nan and inf
+    float max_lod = context.texture->GetMipLevelCount() - 1;
+    float lod = 0.5f * std::log2( rho_squared );
+    if ( !( lod > 0 ) )
+        lod = 0;
+    lod = std::min( lod, max_lod );
+
+    Uint8 level = blend_levels ? (Uint8) lod : (Uint8) ( lod + 0.5f );
+    context.level = TextureLevel( *context.texture, level );
+    if ( blend_levels )
+    {
+        context.level_blend = ( lod - level ) * 256.0f;
+        context.next_level = TextureLevel( *context.texture, std::min< int >( level + 1, max_lod ) );
+    }
+}
+
+template< Uint16 state >
+void Rasteriser::DrawPipelineSpan( const Spanf& span )
+{
+    // only pixels inside of our area are drawn. Interpolants keep their origin at span.x_begin
+    // so that every pixel gets the same values no matter how the screen is split up.
+    int x_first = std::max( span.x_begin, (int) x_begin );
+    int x_last  = std::min( span.x_end, (int) x_end ); // exclusive
+    if ( x_first >= x_last )
+        return;
+    ClearPendingTiles( x_first, x_last, span.y );
+
+    SpanContext context = triangle_context;
+    context.z_row = z_buffer.data() + ( span.y - y_begin ) * r_texture->GetWidth();
+    context.colour_row = colour_pixels + ( span.y - y_begin ) * colour_pitch;
+    if constexpr ( ( state & pipeline_filter_mask ) != pipeline_filter_nearest )
+        SelectMipLevels( context, span, ( state & pipeline_filter_mask ) == pipeline_filter_trilinear );
+
+    // kernels index rows relative to x_begin
+    Spanf local_span = span;
+    local_span.x_begin -= x_begin;
+    local_span.x_end   -= x_begin;
+
+    if constexpr ( !( state & pipeline_depth_test ) )
+    {
+        DrawFragments< state >( context, local_span, x_first - x_begin, x_last - x_begin );
+        return;
+    }
+
+    // walk span tile by tile so that tiles hidden according to the hierarchical z buffer can
+    // be skipped. Depth is linear, so the nearest depth of a segment is at one of its ends.
+    // Visible segments are drawn together.
+    int x_draw = x_first;
+    for ( int x = x_first; x < x_last; )
+    {
+        int x_stop = std::min( x_last, ( x / block_size + 1 ) * block_size );
+        Uint32 hiz_index = GetHiZIndex( x, span.y );
+        float depth_first = span.Get( attribute_depth, (float) ( x - span.x_begin ) );
+        float depth_last  = span.Get( attribute_depth, (float) ( x_stop - 1 - span.x_begin ) );
+
+        if ( IsTileOccluded( hiz_index, std::min( depth_first, depth_last ) ) )
+        {
+            if ( x_draw < x )
+                DrawFragments< state >( context, local_span, x_draw - x_begin, x - x_begin );
+            x_draw = x_stop;
+        }
+        else if constexpr ( state & pipeline_depth_write )
+        {
+            TouchHiZ( hiz_index );
+        }
+        x = x_stop;
+    }
+
+    if ( x_draw < x_last )
+        DrawFragments< state >( context, local_span, x_draw - x_begin, x_last - x_begin );
+}
+
+bool Rasteriser::GetRunTexels( float a, float b, float one_over_length, int size, Sint32& start, Sint32& step )
+{
+    // Converts texcoords a and b at both ends of an affine run to a start and a step per pixel
+    // in fixed point texels. Fails if they don't fit, e.g. on clamped texcoords far outside.
+    const float scale = (float) size * (float) ( 1 << run_fixed_shift );
+    float fixed_start = a * scale;
+    float fixed_step  = ( b - a ) * one_over_length * scale;
+    if ( !( std::abs( fixed_start ) + std::abs( fixed_step ) * perspectiveStep <= max_run_texels * (float) ( 1 << run_fixed_shift ) ) )
+        return false;
+    start = (Sint32) fixed_start;
+    step  = (Sint32) fixed_step;
+    return true;
+}
+
+template< Uint16 state >
+void Rasteriser::DrawFragments( const SpanContext& context, const Spanf& span, int x_first, int x_stop )
+{
+    // draws pixels x_first to x_stop
+    if constexpr ( state == ( pipeline_depth_test | pipeline_depth_write ) )
+    {
+        DrawDepthFragments< state >( context, span, x_first, x_stop );
+        return;
+    }
+    else if constexpr ( state == pipeline_colour_write )
+    {
+        // flat colour without z buffer, nothing to interpolate
+        std::fill( context.colour_row + x_first, context.colour_row + x_stop, context.colour );
+        return;
+    }
+    else if constexpr ( !( state & pipeline_affine_runs ) )
+    {
+        DrawFragmentKernels< state >( context, span, x_first, x_stop );
+        return;
+    }
+
+    // dividing each pixel is cheaper on short spans. Judged by the whole span so that
+    // results don't depend on how it is cut.
+    if ( span.x_end - span.x_begin < perspectiveStep * min_affine_runs )
+    {
+        DrawFragmentKernels< ( state & ~pipeline_affine_runs ) >( context, span, x_first, x_stop );
+        return;
+    }
+
+    // Split span into runs that start at screen columns divisible by perspectiveStep.
+    // Texcoords are divided by oneOverZ at both ends of a run and texels are stepped
+    // linearly in 16.16 fixed point in between, so kernels neither divide nor convert.
+    // Ends are clamped to the span instead of to x_first and x_stop, hence a pixel gets
+    // the same texels however a span is cut. Runs where that is too far off (e.g. steep
+    // floors) or whose texels don't fit are corrected pixel by pixel.
+    SpanContext run_context = context;
+    AffineRun& run = run_context.run;
+    int run_begin = -1; // left end of run whose texcoords are in u_begin and v_begin
+    float u_begin = 0, v_begin = 0, oneOverZ_begin = 0;
+    for ( int x = x_first; x < x_stop; )
+    {
+        int run_base = ( ( x + x_begin ) & -perspectiveStep ) - x_begin; // perspectiveStep is a power of two
+        int x_run_stop = std::min( x_stop, run_base + perspectiveStep );
+        int run_end = std::min( run_base + perspectiveStep, span.x_end - 1 );
+        float i_end = run_end - span.x_begin;
+        float oneOverZ_end = span.Get( attribute_oneOverZ, i_end );
+        float z_end = 1.0f / oneOverZ_end;
+        float u_end = span.Get( attribute_texCoordX, i_end ) * z_end;
+        float v_end = span.Get( attribute_texCoordY, i_end ) * z_end;
+
+        // left end is the right end of the previous run, unless runs were skipped
+        int new_begin = std::max( run_base, span.x_begin );
+        if ( new_begin != run_begin )
+        {
+            run_begin = new_begin;
+            float i_begin = run_begin - span.x_begin;
+            oneOverZ_begin = span.Get( attribute_oneOverZ, i_begin );
+            float z_begin = 1.0f / oneOverZ_begin;
+            u_begin = span.Get( attribute_texCoordX, i_begin ) * z_begin;
+            v_begin = span.Get( attribute_texCoordY, i_begin ) * z_begin;
+        }
+
+        // Linear interpolation of texCoord / oneOverZ between two points is off by at most
+        // a quarter of the texcoord difference times the relative change of oneOverZ.
+        float texel_distance = std::abs( u_end - u_begin ) * context.level.width + std::abs( v_end - v_begin ) * context.level.height;
+        bool affine = texel_distance * std::abs( oneOverZ_end - oneOverZ_begin ) <= max_affine_error * 4.0f * std::min( oneOverZ_begin, oneOverZ_end );
+        if ( affine )
+        {
+            // texcoords are moved by whole wrap periods so that the run starts near zero
+            float u_shift = PipelineSampler< state >::GetWrapShift( u_begin );
+            float v_shift = PipelineSampler< state >::GetWrapShift( v_begin );
+            float one_over_length = 1.0f / std::max( run_end - run_begin, 1 );
+            run.origin = run_begin;
+            affine = GetRunTexels( u_begin - u_shift, u_end - u_shift, one_over_length, context.level.width,  run.x[0], run.x_step[0] ) &&
+                     GetRunTexels( v_begin - v_shift, v_end - v_shift, one_over_length, context.level.height, run.y[0], run.y_step[0] );
+            if constexpr ( ( state & pipeline_filter_mask ) == pipeline_filter_trilinear )
+            {
+                affine = affine &&
+                         GetRunTexels( u_begin - u_shift, u_end - u_shift, one_over_length, context.next_level.width,  run.x[1], run.x_step[1] ) &&
+                         GetRunTexels( v_begin - v_shift, v_end - v_shift, one_over_length, context.next_level.height, run.y[1], run.y_step[1] );
+            }
         }
+
+        if ( affine )
+            DrawFragmentKernels< state >( run_context, span, x, x_run_stop );
         else
         {
-            DrawFragment( x, yCoord - y_begin, current_depth );
+            DrawFragmentKernels< ( state & ~pipeline_affine_runs ) >( context, span, x, x_run_stop );
         }
 
-        // add steps
-        current_texCoordX += texCoordXX_step;
-        current_texCoordY += texCoordYX_step;
-        current_oneOverZ  += oneOverZX_step;
-        current_depth     += depthX_step;
+        run_begin = run_end;
+        u_begin = u_end;
+        v_begin = v_end;
+        oneOverZ_begin = oneOverZ_end;
+        x = x_run_stop;
+    }
+}
+
+template< Uint16 state >
+void Rasteriser::DrawFragmentKernels( const SpanContext& context, const Spanf& span, int x_first, int x_stop )
+{
+    // draws pixels x_first to x_stop with the widest kernel available
+#if defined( __AVX2__ )
+    for ( int x = x_first - x_first % 8; x < x_stop; x += 8 )
+    {
+        DrawFragments8< state >( context, span, x, x_first, x_stop );
     }
+#else
+    int x = x_first;
+    #if defined( __SSE4_1__ )
+    for ( ; x + 4 <= x_stop; x += 4 )
+    {
+        DrawFragments4< state >( context, span, x );
+    }
+    #endif
+    for ( ; x < x_stop; x++ )
+    {
+        DrawFragment< state >( context, span, x );
+    }
+#endif
+}
+
+// Interpolants are always evaluated as value + step * i with i being the distance to x_begin.
+// Unlike adding up steps this is the same for every kernel width, so all kernels give bit
+// identical results (as long as the compiler doesn't fuse multiply-adds, see Makefile).
+
+#if defined( __SSE4_1__ )
+// Span::Get for 4 pixels at once
+static inline __m128 GetAttribute4( const Spanf& span, Uint8 attribute, __m128 i )
+{
+    return _mm_add_ps( _mm_set1_ps( span.values[attribute] ), _mm_mul_ps( _mm_set1_ps( span.steps[attribute] ), i ) );
+}
+
+// texels of an affine run for 4 pixels d away from its origin, shifted down to the samplers' fixed point
+static inline __m128i GetRunTexels4( Sint32 start, Sint32 step, __m128i d, int shift )
+{
+    return _mm_sra_epi32( _mm_add_epi32( _mm_set1_epi32( start ), _mm_mullo_epi32( _mm_set1_epi32( step ), d ) ), _mm_cvtsi32_si128( shift ) );
+}
+#endif
+
+#if defined( __AVX2__ )
+// Span::Get for 8 pixels at once
+static inline __m256 GetAttribute8( const Spanf& span, Uint8 attribute, __m256 i )
+{
+    return _mm256_add_ps( _mm256_set1_ps( span.values[attribute] ), _mm256_mul_ps( _mm256_set1_ps( span.steps[attribute] ), i ) );
 }
 
-inline void Rasteriser::DrawFragment( Uint16 x, Uint16 y, float current_depth, Uint16 texcoordX, Uint16 texcoordY )
+// texels of an affine run for 8 pixels d away from its origin, shifted down to the samplers' fixed point
+static inline __m256i GetRunTexels8( Sint32 start, Sint32 step, __m256i d, int shift )
 {
+    return _mm256_sra_epi32( _mm256_add_epi32( _mm256_set1_epi32( start ), _mm256_mullo_epi32( _mm256_set1_epi32( step ), d ) ), _mm_cvtsi32_si128( shift ) );
+}
+#endif
+
+template< Uint16 state >
+inline void Rasteriser::DrawFragment( const SpanContext& context, const Spanf& span, int x )
+{
+    float i = x - span.x_begin;
+    float current_depth = span.Get( attribute_depth, i );
+
     // depth test
-//    if ( ignoreZBuffer || ( current_depth <= GetZ( x * y ) && current_depth >= near_z && current_depth <= far_z ) )
-    if ( ignoreZBuffer || current_depth <= GetZ( x, y ) )
+    if constexpr ( ( state & pipeline_depth_test ) && ( state & pipeline_depth_equal ) )
     {
-        /*
-        if ( printDebug ) [[unlikely]]
-        {
-            cout << "Pixel passed z-test with " << current_depth << ". Z-Buffer was " << GetZ( x * (int) y ) << endl;
-        }
-        */
-        SetZ( x, y, current_depth );
-        int offset = y * r_texture->GetWidth() + x;
-        r_texture->t_pixels.at( offset ) = current_vpoo.texture->t_pixels.at( 
-                                                    current_vpoo.texture->GetWidth() * texcoordY + texcoordX );
+        if ( current_depth != context.z_row[x] )
+            return;
+    }
+    else if constexpr ( state & pipeline_depth_test )
+    {
+        if ( !( current_depth <= context.z_row[x] ) )
+            return;
     }
+
+    Uint32 pixel = context.colour;
+    if constexpr ( state & pipeline_affine_runs )
+    {
+        const AffineRun& run = context.run;
+        const int shift = run_fixed_shift - sampler_fixed_shift;
+        int d = x - run.origin;
+        pixel = PipelineSampler< state >::SampleTexels( context.level, context.next_level, context.level_blend,
+                                                        ( run.x[0] + run.x_step[0] * d ) >> shift, ( run.y[0] + run.y_step[0] * d ) >> shift,
+                                                        ( run.x[1] + run.x_step[1] * d ) >> shift, ( run.y[1] + run.y_step[1] * d ) >> shift );
+    }
+    else if constexpr ( state & pipeline_textured )
+    {
+        float z = 1.0f / span.Get( attribute_oneOverZ, i );
+        float current_texCoordX = span.Get( attribute_texCoordX, i ) * z;
+        float current_texCoordY = span.Get( attribute_texCoordY, i ) * z;
+
+        pixel = PipelineSampler< state >::Sample( context.level, context.next_level, context.level_blend,
+                                                  current_texCoordX, current_texCoordY );
+    }
+
+    if constexpr ( state & pipeline_depth_write )
+        context.z_row[x] = current_depth;
+    if constexpr ( state & pipeline_colour_write )
+        context.colour_row[x] = pixel;
 }
 
-inline void Rasteriser::DrawFragment( Uint16 x, Uint16 y, float current_depth )
+#if defined( __SSE4_1__ )
+template< Uint16 state >
+inline void Rasteriser::DrawFragments4( const SpanContext& context, const Spanf& span, int x )
 {
+    // SSE4.1 version of DrawFragment for 4 pixels at once. There is no gather, so texels are
+    // fetched one by one.
+    const __m128 i = _mm_add_ps( _mm_set1_ps( (float) ( x - span.x_begin ) ), _mm_setr_ps( 0, 1, 2, 3 ) );
+    const __m128 depth = GetAttribute4( span, attribute_depth, i );
+
     // depth test
-//    if ( ignoreZBuffer || ( current_depth <= GetZ( x, y ) && current_depth >= near_z && current_depth <= far_z ) )
-    if ( ignoreZBuffer || current_depth <= GetZ( x, y ) )
+    __m128 mask = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+    __m128 z_old = depth;
+    if constexpr ( state & pipeline_depth_test )
     {
-        /*
-        if ( printDebug ) [[unlikely]]
+        z_old = _mm_loadu_ps( context.z_row + x );
+        if constexpr ( state & pipeline_depth_equal )
+            mask = _mm_cmpeq_ps( depth, z_old );
+        else
+            mask = _mm_cmple_ps( depth, z_old );
+        if ( _mm_movemask_ps( mask ) == 0 )
+            return;
+    }
+
+    __m128i pixels = _mm_set1_epi32( context.colour );
+    if constexpr ( state & pipeline_affine_runs )
+    {
+        const AffineRun& run = context.run;
+        const int shift = run_fixed_shift - sampler_fixed_shift;
+        const __m128i d = _mm_add_epi32( _mm_set1_epi32( x - run.origin ), _mm_setr_epi32( 0, 1, 2, 3 ) );
+        pixels = PipelineSampler< state >::SampleTexels4( context.level, context.next_level, context.level_blend,
+                                                          GetRunTexels4( run.x[0], run.x_step[0], d, shift ), GetRunTexels4( run.y[0], run.y_step[0], d, shift ),
+                                                          GetRunTexels4( run.x[1], run.x_step[1], d, shift ), GetRunTexels4( run.y[1], run.y_step[1], d, shift ) );
+    }
+    else if constexpr ( state & pipeline_textured )
+    {
+        __m128 oneOverZ = GetAttribute4( span, attribute_oneOverZ, i );
+        __m128 z = _mm_div_ps( _mm_set1_ps( 1.0f ), oneOverZ );
+        __m128 texCoordX = _mm_mul_ps( GetAttribute4( span, attribute_texCoordX, i ), z );
+        __m128 texCoordY = _mm_mul_ps( GetAttribute4( span, attribute_texCoordY, i ), z );
+
+        pixels = PipelineSampler< state >::Sample4( context.level, context.next_level, context.level_blend, texCoordX, texCoordY );
+    }
+
+    // masked store of depth and colour
+    if constexpr ( state & pipeline_depth_write )
+        _mm_storeu_ps( context.z_row + x, _mm_blendv_ps( z_old, depth, mask ) );
+    if constexpr ( state & pipeline_colour_write )
+    {
+        if constexpr ( state & pipeline_depth_test )
         {
-            cout << "Pixel passed z-test with " << current_depth << ". Z-Buffer was " << GetZ( x * (int) y ) << endl;
+            __m128i colour_old = _mm_loadu_si128( (const __m128i*) ( context.colour_row + x ) );
+            pixels = _mm_blendv_epi8( colour_old, pixels, _mm_castps_si128( mask ) );
         }
-        */
-        SetZ( x, y, current_depth );
-        int offset = y * r_texture->GetWidth() + x;
-        r_texture->t_pixels.at( offset ) = getPixelFor_SDLColor( &current_vpoo.colour );
+        _mm_storeu_si128( (__m128i*) ( context.colour_row + x ), pixels );
+    }
+}
+#endif
+
+#if defined( __AVX2__ )
+template< Uint16 state >
+inline void Rasteriser::DrawFragments8( const SpanContext& context, const Spanf& span, int x, int x_first, int x_stop )
+{
+    // AVX2 version of DrawFragment for 8 pixels at once. x is aligned to 8 pixels, lanes
+    // outside of x_first to x_stop are masked out (including their memory accesses).
+    const __m256i lane_x = _mm256_add_epi32( _mm256_set1_epi32( x ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+    __m256 mask = _mm256_castsi256_ps( _mm256_andnot_si256( _mm256_cmpgt_epi32( _mm256_set1_epi32( x_first ), lane_x ),
+                                                            _mm256_cmpgt_epi32( _mm256_set1_epi32( x_stop ), lane_x ) ) );
+
+    const __m256 i = _mm256_add_ps( _mm256_set1_ps( (float) ( x - span.x_begin ) ), _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+    const __m256 depth = GetAttribute8( span, attribute_depth, i );
+
+    // depth test
+    if constexpr ( state & pipeline_depth_test )
+    {
+        const __m256 z_old = _mm256_maskload_ps( context.z_row + x, _mm256_castps_si256( mask ) );
+        if constexpr ( state & pipeline_depth_equal )
+            mask = _mm256_and_ps( mask, _mm256_cmp_ps( depth, z_old, _CMP_EQ_OQ ) );
+        else
+            mask = _mm256_and_ps( mask, _mm256_cmp_ps( depth, z_old, _CMP_LE_OQ ) );
+        if ( _mm256_movemask_ps( mask ) == 0 )
+            return;
+    }
+
+    // only texels of pixels that passed the depth test are fetched
+    __m256i pixels = _mm256_set1_epi32( context.colour );
+    if constexpr ( state & pipeline_affine_runs )
+    {
+        const AffineRun& run = context.run;
+        const int shift = run_fixed_shift - sampler_fixed_shift;
+        const __m256i d = _mm256_sub_epi32( lane_x, _mm256_set1_epi32( run.origin ) );
+        pixels = PipelineSampler< state >::SampleTexels8( context.level, context.next_level, context.level_blend,
+                                                          GetRunTexels8( run.x[0], run.x_step[0], d, shift ), GetRunTexels8( run.y[0], run.y_step[0], d, shift ),
+                                                          GetRunTexels8( run.x[1], run.x_step[1], d, shift ), GetRunTexels8( run.y[1], run.y_step[1], d, shift ),
+                                                          _mm256_castps_si256( mask ) );
+    }
+    else if constexpr ( state & pipeline_textured )
+    {
+        __m256 oneOverZ = GetAttribute8( span, attribute_oneOverZ, i );
+        __m256 z = _mm256_div_ps( _mm256_set1_ps( 1.0f ), oneOverZ );
+        __m256 texCoordX = _mm256_mul_ps( GetAttribute8( span, attribute_texCoordX, i ), z );
+        __m256 texCoordY = _mm256_mul_ps( GetAttribute8( span, attribute_texCoordY, i ), z );
+
+        pixels = PipelineSampler< state >::Sample8( context.level, context.next_level, context.level_blend,
+                                                    texCoordX, texCoordY, _mm256_castps_si256( mask ) );
+    }
+
+    // masked store of depth and colour
+    if constexpr ( state & pipeline_depth_write )
+        _mm256_maskstore_ps( context.z_row + x, _mm256_castps_si256( mask ), depth );
+    if constexpr ( state & pipeline_colour_write )
+        _mm256_maskstore_epi32( (int*) ( context.colour_row + x ), _mm256_castps_si256( mask ), pixels );
+}
+#endif
+
+template< Uint16 state >
+void Rasteriser::DrawDepthFragments( const SpanContext& context, const Spanf& span, int x_first, int x_stop )
+{
+    // version of DrawFragments for depth only pipelines. Nothing but depth is interpolated.
+    // Depth is calculated exactly like in the other kernels so that the second pass finds equal values.
+    int x = x_first;
+#if defined( __AVX2__ )
+    for ( ; x + 8 <= x_stop; x += 8 )
+    {
+        const __m256 i = _mm256_add_ps( _mm256_set1_ps( (float) ( x - span.x_begin ) ), _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+        const __m256 depth = GetAttribute8( span, attribute_depth, i );
+        const __m256 z_old = _mm256_loadu_ps( context.z_row + x );
+        _mm256_storeu_ps( context.z_row + x, _mm256_blendv_ps( z_old, depth, _mm256_cmp_ps( depth, z_old, _CMP_LE_OQ ) ) );
+    }
+#elif defined( __SSE4_1__ )
+    for ( ; x + 4 <= x_stop; x += 4 )
+    {
+        const __m128 i = _mm_add_ps( _mm_set1_ps( (float) ( x - span.x_begin ) ), _mm_setr_ps( 0, 1, 2, 3 ) );
+        const __m128 depth = GetAttribute4( span, attribute_depth, i );
+        const __m128 z_old = _mm_loadu_ps( context.z_row + x );
+        _mm_storeu_ps( context.z_row + x, _mm_blendv_ps( z_old, depth, _mm_cmple_ps( depth, z_old ) ) );
+    }
+#endif
+    for ( ; x < x_stop; x++ )
+    {
+        float depth = span.Get( attribute_depth, (float) ( x - span.x_begin ) );
+        if ( depth <= context.z_row[x] )
+            context.z_row[x] = depth;
     }
 }
 
@@ -3,53 +3,244 @@
 
 #include "common.h"
 #include "types/Edge.h"
+#include "types/EdgeFunction.h"
+#include "types/FixedEdge.h"
+#include "types/Sampler.h"
+#include "types/Span.h"
 #include "types/TexCoordsForEdge.h"
 #include "types/Texture.h"
 #include "types/Mesh.h"
 #include "types/Triangle.h"
-#include "types/SafeDeque.h"
+#include "types/AppendLog.h"
 #include "types/VertexProcessorObjs.h"
+#include <array>
+#include <chrono>
+#include <utility>
 
 class Rasteriser
 {
     // rasterises triangles and blits them onto the screen using a Window object
     //
     // Our fill convention is top-left (so make sure to use ceil!)
+    //
+    // Triangles are either walked scanline by scanline along their edges or,
+    // if blockRasterisation is set, covered by evaluating their edge functions
+    // over 64x64 tiles and 8x8 blocks. Both backends emit spans.
+    // With fixedPointRasterisation the scanline backend snaps vertices to 28.4
+    // fixed point and walks edges with integers (see FixedEdge).
+    // Small triangles skip the attribute edges of the float scanline backend
+    // and get their interpolants from plane equations (see ScanSmallTriangle).
+    //
+    // With depthPrepass every triangle is rasterised twice. The first pass only
+    // fills the z buffer, the second one shades pixels whose depth equals the
+    // stored one. Hence every pixel is textured only once.
+    //
+    // Textures are sampled as set by textureFilter. Filters with mipmaps pick their
+    // level once per span from the texcoord derivatives in its middle.
+    // With perspectiveStep texcoords are only divided by oneOverZ every few pixels
+    // and interpolated linearly in between (see DrawFragments).
+    //
+    // Each rasteriser draws a rectangular part of the screen. That is either a
+    // horizontal band or, if tiledRasterisation is set, a single tile.
+    // Gradients and edges of triangles come precomputed from the vertex
+    // processors (see TriangleSetup), so sharing triangles costs little.
     public:
-        Rasteriser( shared_ptr< SafeDeque< VPOO > > in, const Uint16& frame_width, const Uint16& frame_height , const Uint16& y_begin, const Uint16& y_end );
+        Rasteriser( shared_ptr< AppendLog< VPOO > > in, const Uint16& frame_width, const Uint16& frame_height,
+                    const Uint16& x_begin, const Uint16& x_end, const Uint16& y_begin, const Uint16& y_end );
         virtual ~Rasteriser();
 
-        shared_ptr< std::thread > ProcessVPOOArrayAsThread() { return make_shared< std::thread >( &Rasteriser::ProcessVPOOArray, this ); }
         void ProcessVPOOArray();
 
+        // bin we take triangles from. not thread safe, only call in between frames.
+        void SetInput( const shared_ptr< AppendLog< VPOO > >& in ) { in_vpoos = in; }
+        // changes the area we draw in. not thread safe, only call in between frames.
+        void SetArea( const Uint16& x_begin, const Uint16& x_end, const Uint16& y_begin, const Uint16& y_end );
+        // draw colours into pixels instead of r_texture. pixels points at x_begin, y_begin and rows are
+        // pitch pixels apart. SetArea goes back to r_texture. not thread safe, only call in between frames.
+        void SetColourTarget( Uint32* pixels, Uint32 pitch ) { colour_pixels = pixels; colour_pitch = pitch; }
+        // time spent on the last frame excluding waits for vertex processors
+        Uint64 GetBusyTimeNs() const { return busy_time_ns; }
+
         float near_z = 0, far_z = 0; // contains current near and far plane for culling
-        Uint16 y_begin = 0, y_end = 0; // area in which rasteriser is supposed to draw in.
+        Uint16 x_begin = 0, x_end = 0; // area in which rasteriser is supposed to draw in.
+        Uint16 y_begin = 0, y_end = 0;
         Uint16 frame_width = 0, frame_height = 0; // area in which rasteriser is supposed to draw in.
 
-        shared_ptr< Texture > r_texture = nullptr;
+        shared_ptr< Texture > r_texture = nullptr; // colour buffer unless SetColourTarget gave us another one
+
+        // block rasteriser granularity in pixels
+        static const Uint8 tile_size  = 64;
+        static const Uint8 block_size = 8;
+        // distance in pixels that tiles and blocks need to stay inside of all edges so
+        // that they can be filled without testing pixels
+        static constexpr float trivial_accept_margin = 1.0f / 64;
 
     private:
 
         //-- render vars
         std::vector< float > z_buffer;
+        // pixel at x_begin, y_begin and row pitch of the colour buffer we draw to (see SetColourTarget)
+        Uint32* colour_pixels = nullptr;
+        Uint32 colour_pitch = 0;
+
+        // Hierarchical z buffer. Holds the farthest depth of each screen aligned
+        // block_size x block_size tile of z_buffer. Tiles written by a triangle are
+        // marked stale once the triangle is done. Their value is then too far (which
+        // is still safe for rejecting) and only gets recalculated if that could lead
+        // to a rejection.
+        static const Uint8 hiz_valid   = 0;
+        static const Uint8 hiz_touched = 1; // written by current triangle
+        static const Uint8 hiz_stale   = 2;
+        std::vector< float > hiz_buffer;
+        std::vector< Uint8 > hiz_state;
+        std::vector< Uint32 > hiz_touched_tiles;
+        Uint16 hiz_width = 0, hiz_height = 0;
+
+        // Buffers are cleared lazily on the tiles of the hierarchical z buffer. A tile
+        // gets its clear values once the first span reaches it. The colour of tiles
+        // nobody drew to is filled in when the frame is done.
+        std::vector< Uint8 > tile_clear_pending;
+        Uint32 clear_pixel = 0;
+
+        Uint64 busy_time_ns = 0;
+
+        // pass of depthPrepass we are currently in
+        static const Uint8 pass_all   = 0; // no depth pre-pass
+        static const Uint8 pass_depth = 1;
+        static const Uint8 pass_shade = 2;
+        Uint8 current_pass = pass_all;
+        void ProcessAllVPOOs( std::chrono::steady_clock::duration& busy_time );
 
         void initFramebuffer();
         void finaliseFrame();
 
-        shared_ptr< SafeDeque< VPOO > > in_vpoos = nullptr;
+        shared_ptr< AppendLog< VPOO > > in_vpoos = nullptr;
         VPOO current_vpoo;
 
-        float GetZ( const Uint32& index ) const;
-        inline float GetZ( const Uint16& x, const Uint16& y ) const { return GetZ( y*r_texture->GetWidth() + x ); }
-        void SetZ( const Uint32& index, const float& z_value );
-        inline void SetZ( const Uint16& x, const Uint16& y, const float& z_value ) { SetZ( y*r_texture->GetWidth() + x, z_value ); }
+        // Pipeline state. Span drawing and fragment kernels are templates on a combination
+        // of these bits. Each triangle looks up the span function compiled for its state once,
+        // so kernels never branch on render settings per pixel. New render states are added
+        // as another bit that the kernels check with if constexpr.
+        static const Uint8 pipeline_textured     = 1 << 0; // texels instead of a flat colour
+        static const Uint8 pipeline_depth_test   = 1 << 1;
+        static const Uint8 pipeline_depth_equal  = 1 << 2; // pass where depth equals stored depth instead of being less or equal
+        static const Uint8 pipeline_depth_write  = 1 << 3;
+        static const Uint8 pipeline_colour_write = 1 << 4;
+        // texture filter. all but nearest pick a mip level per span.
+        static const Uint8 pipeline_filter_nearest   = 0 << 5;
+        static const Uint8 pipeline_filter_mipmapped = 1 << 5; // nearest texel of nearest level
+        static const Uint8 pipeline_filter_bilinear  = 2 << 5;
+        static const Uint8 pipeline_filter_trilinear = 3 << 5; // bilinear on two levels, blended
+        static const Uint8 pipeline_filter_mask      = 3 << 5;
+        static const Uint8 pipeline_tiled_texture    = 1 << 7; // texture is stored in tiles, see Texture
+        static const Uint16 pipeline_wrap_shift      = 8; // wrap mode of texture, see Texture
+        static const Uint16 pipeline_wrap_mask       = 3 << pipeline_wrap_shift;
+        static const Uint16 pipeline_pow2_texture    = 1 << 10; // width and height are powers of two
+        static const Uint16 pipeline_affine_runs     = 1 << 11; // texcoords are perspective corrected every perspectiveStep pixels
+        static const Uint16 pipeline_state_count = 1 << 12;
+
+        // only states that SetupPipeline can produce get compiled
+        static constexpr bool IsValidPipelineState( Uint16 state )
+        {
+            Uint16 depth = state & ( pipeline_depth_test | pipeline_depth_equal | pipeline_depth_write | pipeline_colour_write );
+            bool valid_depth = depth == pipeline_colour_write ||
+                               depth == ( pipeline_depth_test | pipeline_depth_write | pipeline_colour_write ) ||
+                               depth == ( pipeline_depth_test | pipeline_depth_equal | pipeline_colour_write ) ||
+                               depth == ( pipeline_depth_test | pipeline_depth_write );
+            bool sampler_state = state & ( pipeline_filter_mask | pipeline_tiled_texture | pipeline_wrap_mask | pipeline_pow2_texture | pipeline_affine_runs );
+            if ( !( state & pipeline_textured ) )
+                return valid_depth && !sampler_state;
+            return valid_depth && ( state & pipeline_colour_write ) && ( state & pipeline_wrap_mask ) >> pipeline_wrap_shift <= Texture::wrap_mirror;
+        }
+
+        template< Uint16 state >
+        using PipelineSampler = Sampler< ( ( state & pipeline_filter_mask ) == pipeline_filter_trilinear ? sampler_filter_trilinear :
+                                           ( state & pipeline_filter_mask ) == pipeline_filter_bilinear  ? sampler_filter_bilinear : sampler_filter_nearest ),
+                                         ( ( state & pipeline_wrap_mask ) >> pipeline_wrap_shift ),
+                                         ( ( state & pipeline_tiled_texture ) != 0 ), ( ( state & pipeline_pow2_texture ) != 0 ) >;
+
+        // Texels of an affine run in 16.16 fixed point, [0] on level and [1] on next_level.
+        // Pixel x gets x + x_step * ( x - origin ), see DrawFragments.
+        struct AffineRun
+        {
+            int origin = 0;
+            Sint32 x[2] = {}, y[2] = {}, x_step[2] = {}, y_step[2] = {};
+        };
+        static const int run_fixed_shift = 16;
+        // runs stay within this many texels of zero so that stepping can't overflow
+        static constexpr float max_run_texels = 1 << 14;
+        static bool GetRunTexels( float a, float b, float one_over_length, int size, Sint32& start, Sint32& step );
+
+        // Everything the fragment kernels need to know about the row a span is drawn on.
+        // Texture and colour are resolved once per triangle, rows and mip levels once per
+        // span, so that the per pixel loop only does raw pointer accesses.
+        // Rows start at x_begin, hence kernels get spans that are relative to x_begin.
+        struct SpanContext
+        {
+            float*  z_row = nullptr;
+            Uint32* colour_row = nullptr;
+            const Texture* texture = nullptr; // nullptr if span is drawn with a flat colour
+            TextureLevel level;
+            TextureLevel next_level; // only used by trilinear filtering
+            Uint32 level_blend = 0;  // weight of next_level from 0 to 256
+            Uint32 colour = 0;
+            // texcoord gradients along y for picking mip levels. x gradients are part of spans.
+            float texCoordX_YStep = 0, texCoordY_YStep = 0, oneOverZ_YStep = 0;
+            AffineRun run; // only used by pipelines with affine runs
+        };
+        SpanContext triangle_context;
+
+        typedef void ( Rasteriser::*DrawSpanFunction )( const Spanf& span );
+        DrawSpanFunction draw_span = nullptr; // specialisation for the current triangle
+        static const std::array< DrawSpanFunction, pipeline_state_count > draw_span_functions;
+        template< std::size_t... states >
+        static constexpr std::array< DrawSpanFunction, pipeline_state_count > GetDrawSpanFunctions( std::index_sequence< states... > )
+        {
+            return { GetDrawSpanFunction< states >()... };
+        }
+        template< Uint16 state >
+        static constexpr DrawSpanFunction GetDrawSpanFunction()
+        {
+            if constexpr ( IsValidPipelineState( state ) )
+                return &Rasteriser::DrawPipelineSpan< state >;
+            else
+                return nullptr;
+        }
+        void SetupPipeline( const TexCoordsForEdgef& texcoords );
+        void SelectMipLevels( SpanContext& context, const Spanf& span, bool blend_levels ) const;
+
+        inline Uint32 GetHiZIndex( int x, int y ) const { return ( y / block_size - y_begin / block_size ) * hiz_width + x / block_size - x_begin / block_size; }
+        bool IsTileOccluded( Uint32 hiz_index, float min_depth );
+        void RefreshHiZ( Uint32 hiz_index );
+        void TouchHiZ( Uint32 hiz_index );
+        void MarkTouchedHiZStale();
+        void GetHiZTileArea( Uint32 hiz_index, int& x_start, int& y_start, int& x_stop, int& y_stop ) const;
+        void ClearTile( Uint32 hiz_index, bool clear_depth );
+        inline void ClearPendingTiles( int x_first, int x_last, int y );
 
         void ProcessCurrentVPOO();
-        void ScanTriangle( const Vertexf& vertMin, const Vertexf& vertMid, const Vertexf& vertMax, bool isRightHanded );
+        bool ScanTriangleFixed( const Vertexf& vertMin, const Vertexf& vertMid, const Vertexf& vertMax, const TexCoordsForEdgef& texcoords );
+        void ScanEdgesFixed( FixedEdge& longEdge, FixedEdge& shortEdge, bool longEdgeIsLeft, const Vertexf& vertMin, const TexCoordsForEdgef& texcoords );
+        void ScanSmallTriangle( const Vertexf& vertMin, const Vertexf& vertMid, const Vertexf& vertMax, const TexCoordsForEdgef& texcoords, bool isRightHanded );
         void ScanEdges( Edgef& a, Edgef& b, bool isRightHanded );
         void DrawScanLine( const Edgef& left, const Edgef& right, Uint16 yCoord );
-        void DrawFragment( Uint16 x, Uint16 y, float current_depth, Uint16 texcoordX, Uint16 texcoordY );
-        void DrawFragment( Uint16 x, Uint16 y, float current_depth );
+        void RasteriseBlocks( const Vertexf& vertMin, const Vertexf& vertMid, const Vertexf& vertMax, const TexCoordsForEdgef& texcoords );
+        void RasteriseBlock( const EdgeFunctionf (&edges)[3], const Vertexf& vertMin, const TexCoordsForEdgef& texcoords,
+                             int x_start, int y_start, int x_stop, int y_stop );
+        Spanf GetPlaneSpan( const Vertexf& vertMin, const TexCoordsForEdgef& texcoords, int x_begin, int x_end, int y ) const;
+        inline void DrawSpan( const Spanf& span ) { ( this->*draw_span )( span ); }
+        template< Uint16 state > void DrawPipelineSpan( const Spanf& span );
+        template< Uint16 state > void DrawFragments( const SpanContext& context, const Spanf& span, int x_first, int x_stop );
+        template< Uint16 state > void DrawFragmentKernels( const SpanContext& context, const Spanf& span, int x_first, int x_stop );
+        // largest error in texels that linear interpolation between perspective correct
+        // texcoords may have before the pixels of a run are corrected one by one
+        static constexpr float max_affine_error = 0.25f;
+        static const Uint8 min_affine_runs = 2; // spans shorter than this many runs divide every pixel
+        // fragment kernels. all of them produce exactly the same pixels.
+        template< Uint16 state > void DrawFragment( const SpanContext& context, const Spanf& span, int x );
+        template< Uint16 state > void DrawFragments4( const SpanContext& context, const Spanf& span, int x ); // SSE4.1
+        template< Uint16 state > void DrawFragments8( const SpanContext& context, const Spanf& span, int x, int x_first, int x_stop ); // AVX2
+        template< Uint16 state > void DrawDepthFragments( const SpanContext& context, const Spanf& span, int x_first, int x_stop );
 };
 
 #endif // RASTERISER_H
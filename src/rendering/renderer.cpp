@@ -3,42 +3,98 @@
 Renderer::Renderer( Window* window, Uint8 vp_thread_count, Uint8 raster_thread_count )
 {
     w_window = window;
-    SetPerspectiveToScreenSpaceMatrix();
 
     // init vars with defaults
     in_vpios = make_shared< SafeDeque< VPIO > >();
-    out_vpoos = make_shared< SafeDeque< VPOO > >();
+    std::vector< VPOOBin >& out_bins = frames[0].out_bins;
 
-    // create workers (vps and rasterisers)
-    for ( Uint8 i = 0; i < vp_thread_count; i++ )
+    if ( tiledRasterisation )
     {
-        if ( printDebug ) [[unlikely]]
-            cout << "'in_vpios' uses: " << in_vpios.use_count() << " 'out_vpoos' uses: " << out_vpoos.use_count() << endl;
-        vertex_processors.push_back( make_shared< VertexProcessor >( in_vpios, out_vpoos ) );
+        // Split the rendering surface into tiles with one rasteriser each. Each one has their own SDL_Surface
+        // and their own bin of triangles. raster_thread_count workers take tiles from a TileScheduler.
+        Uint16 tile_size = Rasteriser::tile_size;
+        Uint16 tile_rows = ( w_window->Getheight() + tile_size - 1 ) / tile_size;
+        out_bin_columns  = ( w_window->Getwidth()  + tile_size - 1 ) / tile_size;
+        for ( Uint16 row = 0; row < tile_rows; row++ )
+        {
+            for ( Uint16 column = 0; column < out_bin_columns; column++ )
+            {
+                Uint16 x_begin = column * tile_size;
+                Uint16 y_begin = row * tile_size;
+                Uint16 x_end = std::min< Uint16 >( x_begin + tile_size, w_window->Getwidth() );
+                Uint16 y_end = std::min< Uint16 >( y_begin + tile_size, w_window->Getheight() );
+
+                out_bins.push_back( VPOOBin( x_begin, x_end, y_begin, y_end, make_shared< AppendLog< VPOO > >() ) );
+                rasterisers.push_back( make_shared< Rasteriser >( out_bins.back().vpoos, w_window->Getwidth(), w_window->Getheight(),
+                                                                  x_begin, x_end, y_begin, y_end ) );
+            }
+        }
+
+        raster_worker_count = raster_thread_count;
+        tile_scheduler = make_shared< TileScheduler >( out_bin_columns, tile_rows, raster_worker_count );
+        cout << "Split screen into " << out_bin_columns << "x" << tile_rows << " tiles for " << (int) raster_worker_count << " rasteriser workers" << endl;
+    }
+    else
+    {
+        // For the rasterisers we split the rendering surface vertically into even parts that do not overlap. Each one has their own SDL_Surface
+        // and their own bin of triangles, so that they only see triangles that cover their part.
+        // The borders get moved by RebalanceBands after each frame.
+        for ( Uint8 i = 0; i < raster_thread_count; i++ )
+        {
+            Uint16 y_begin = w_window->Getheight() * i / raster_thread_count;
+            Uint16 y_end   = w_window->Getheight() * ( i + 1 ) / raster_thread_count;
+
+            out_bins.push_back( VPOOBin( 0, w_window->Getwidth(), y_begin, y_end, make_shared< AppendLog< VPOO > >() ) );
+            rasterisers.push_back( make_shared< Rasteriser >( out_bins.back().vpoos, w_window->Getwidth(), w_window->Getheight(),
+                                                              0, w_window->Getwidth(), y_begin, y_end ) );
+            cout << "Rasteriser " << (int) i << " has y_begin " << y_begin << " and y_end " << y_end << endl;
+        }
     }
 
     if ( printDebug ) [[unlikely]]
-        cout << "Spawned " << vertex_processors.size() << " vertex processors." << endl;
+        cout << "Spawned " << rasterisers.size() << " rasterisers." << endl;
 
-    // For the rasterisers we split the rendering surface vertically into even parts that do not overlap. Each one has their own SDL_Surface.
-    float y_count = 0;
-    float y_incre = (float) (w_window->Getheight() - 1) / (float) raster_thread_count;
-    for ( Uint8 i = 0; i < raster_thread_count; i++ )
+    // the second frame gets bins of its own for the same areas
+    if ( pipelinedFrames )
     {
-        Uint16 y_begin;
-        if ( y_count > 0 && y_count == (float) y_count )
-            y_begin = y_count - 1;
-        else
-            y_begin = std::ceil( y_count );
-        y_count += y_incre;
-        Uint16 y_end   = std::floor( y_count );
+        for ( const auto& bin : out_bins )
+        {
+            frames[1].out_bins.push_back( VPOOBin( bin.x_begin, bin.x_end, bin.y_begin, bin.y_end, make_shared< AppendLog< VPOO > >() ) );
+        }
+    }
 
-        rasterisers.push_back( make_shared< Rasteriser >( out_vpoos, w_window->Getwidth(), w_window->Getheight(), y_begin, y_end ) );
-        cout << "Rasteriser " << i << " has y_begin " << y_begin << " and y_end " << y_end << endl;
+    // create vertex processors. arenas must not be resized afterwards as they point into them.
+    frames[0].arenas.resize( vp_thread_count + 1 );
+    frames[1].arenas.resize( pipelinedFrames ? vp_thread_count + 1 : 0 );
+    for ( Uint8 i = 0; i < vp_thread_count; i++ )
+    {
+        if ( printDebug ) [[unlikely]]
+            cout << "'in_vpios' uses: " << in_vpios.use_count() << endl;
+        vertex_processors.push_back( make_shared< VertexProcessor >( in_vpios, out_bins, &frames[0].arenas[i], out_bin_columns ) );
     }
 
     if ( printDebug ) [[unlikely]]
-        cout << "Spawned " << rasterisers.size() << " rasterisers." << endl;
+        cout << "Spawned " << vertex_processors.size() << " vertex processors." << endl;
+
+    // has to happen after vertex processors exist as it passes the matrix on to them
+    SetPerspectiveToScreenSpaceMatrix();
+
+    // worker threads are created once and woken up for every frame
+    vp_pool = make_unique< WorkerPool >( vertex_processors.size(), [this]( Uint8 worker )
+    {
+        vertex_processors[ worker ]->ProcessQueue();
+    } );
+    if ( tile_scheduler != nullptr )
+    {
+        raster_pool = make_unique< WorkerPool >( raster_worker_count, [this]( Uint8 worker ) { ProcessTiles( worker ); } );
+    }
+    else
+    {
+        raster_pool = make_unique< WorkerPool >( rasterisers.size(), [this]( Uint8 worker )
+        {
+            rasterisers[ worker ]->ProcessVPOOArray();
+        } );
+    }
 }
 void Renderer::SetObjectToWorldMatrix( const Matrix4f& objectMatrix )
 {
@@ -95,20 +151,31 @@ void Renderer::SetDrawTexture(const shared_ptr< Texture >& texture )
 
 void Renderer::ClearBuffers()
 {
+    // with pipelinedFrames the other frame may still be rasterised, so only the current one is cleared
+    FrameData& frame = frames[ current_frame ];
     in_vpios->clear();
-    out_vpoos->clear();
+    sorted_vpios.clear();
+    frame.textures.clear();
+    for ( auto& bin : frame.out_bins )
+    {
+        bin.vpoos->clear();
+    }
+    for ( auto& arena : frame.arenas )
+    {
+        arena.Reset();
+    }
 }
 
 void Renderer::DrawMesh( const Matrix4f& objMat, shared_ptr<Mesh> mesh, shared_ptr< Texture >& texture)
 {
     VPIO vpio = VPIO( mesh, objMat, texture );
-    in_vpios->push_back( vpio );
+    SubmitVPIO( vpio );
 }
 
 void Renderer::DrawMesh( const Matrix4f& objMat, shared_ptr<Mesh> mesh, const SDL_Color& colour)
 {
     VPIO vpio = VPIO( mesh, objMat, colour );
-    in_vpios->push_back( vpio );
+    SubmitVPIO( vpio );
 }
 
 void Renderer::DrawMesh( const Matrix4f& objMat, shared_ptr<Mesh> mesh)
@@ -116,12 +183,12 @@ void Renderer::DrawMesh( const Matrix4f& objMat, shared_ptr<Mesh> mesh)
     if ( drawWithTexture )
     {
         VPIO vpio = VPIO( mesh, objMat, current_texture );
-        in_vpios->push_back( vpio );
+        SubmitVPIO( vpio );
     }
     else
     {
         VPIO vpio = VPIO( mesh, objMat, *current_colour );
-        in_vpios->push_back( vpio );
+        SubmitVPIO( vpio );
     }
 }
 
@@ -136,81 +203,260 @@ void Renderer::FillTriangle( Triangle tris )
     if ( drawWithTexture )
     {
         VPIO vpio = VPIO( tris, *objMatrix, current_texture );
-        in_vpios->push_back( vpio );
+        SubmitVPIO( vpio );
     }
     else
     {
         VPIO vpio = VPIO( tris, *objMatrix, *current_colour );
-        in_vpios->push_back( vpio );
+        SubmitVPIO( vpio );
     }
 }
 
 void Renderer::InitiateRendering()
 {
+    FrameData& frame = frames[ current_frame ];
     in_vpios->unblock_new();
-    out_vpoos->unblock_new();
+    for ( auto& bin : frame.out_bins )
+    {
+        bin.vpoos->unblock_new();
+    }
+    for ( Uint32 i = 0; i < vertex_processors.size(); i++ )
+    {
+        vertex_processors[i]->SetOutputBins( frame.out_bins, out_bin_columns, &frame.arenas[i] );
+    }
+    vp_pool->Start();
 
-    for ( Uint8 i = 0; i < vertex_processors.size(); i++ )
+    if ( !pipelinedFrames )
     {
-        vp_threads.push_back( vertex_processors[i]->ProcessQueueAsThread() );
+        StartRasterisers( frame );
     }
-    for ( Uint8 i = 0; i < rasterisers.size(); i++ )
+    else if ( raster_pending )
     {
-        rast_threads.push_back( rasterisers[i]->ProcessVPOOArrayAsThread() );
+        // the previous frame is complete and gets drawn while this one is submitted and vertex processed
+        StartRasterisers( frames[ current_frame ^ 1 ] );
     }
 }
 
-void Renderer::WaitUntilFinished()
+void Renderer::StartRasterisers( FrameData& frame )
 {
-    // waits for vertex processing and rasteriser to be finished.
-    // returns once frame is completed
+    // bins may have been moved by RebalanceBands since rasterisers last ran
+    for ( Uint32 i = 0; i < rasterisers.size(); i++ )
+    {
+        const VPOOBin& bin = frame.out_bins[i];
+        Rasteriser& rasteriser = *rasterisers[i];
+        rasteriser.SetInput( bin.vpoos );
+        if ( rasteriser.x_begin != bin.x_begin || rasteriser.x_end != bin.x_end ||
+             rasteriser.y_begin != bin.y_begin || rasteriser.y_end != bin.y_end )
+        {
+            rasteriser.SetArea( bin.x_begin, bin.x_end, bin.y_begin, bin.y_end );
+        }
+    }
+
+    // rasterisers draw straight into the window's pixels, so there is nothing to copy once they are done
+    Uint32 pitch = 0;
+    Uint32* pixels = w_window->GetPixels( pitch );
+    if ( pixels != nullptr )
+    {
+        for ( auto& rasteriser : rasterisers )
+        {
+            rasteriser->SetColourTarget( pixels + rasteriser->y_begin * pitch + rasteriser->x_begin, pitch );
+        }
+    }
+
+    if ( tile_scheduler != nullptr )
+        tile_scheduler->Reset();
+    raster_pool->Start();
+}
+
+void Renderer::ProcessTiles( Uint8 worker )
+{
+    // runs rasterisers of tiles until the scheduler runs out of them
+    Uint32 tile_index;
+    while ( tile_scheduler->NextTile( worker, tile_index ) )
+    {
+        rasterisers[ tile_index ]->ProcessVPOOArray();
+    }
+}
 
+bool Renderer::WaitUntilFinished()
+{
+    // waits for vertex processing and rasteriser to be finished.
+    // returns once frame is completed (with pipelinedFrames the previous one)
+    FrameData& frame = frames[ current_frame ];
 
     // Wait for vertex processors
+    SubmitSortedVPIOs();
     in_vpios->block_new();
-    int i_vp = 0; // tracks vertex_processor processed in queue.
-    for ( auto it = vp_threads.begin(); it != vp_threads.end(); )
-    {
-        vp_threads[0]->join(); // always 0 because we empty the queue and never skip an elemen
+    vp_pool->Wait();
 
-        if ( printDebug ) [[unlikely]]
+    if ( printDebug ) [[unlikely]]
+    {
+        for ( Uint32 i_vp = 0; i_vp < vertex_processors.size(); i_vp++ )
             cout << "VP " << i_vp << " has processed a total of " << (int) vertex_processors[ i_vp ]->GetProcessedVPIOsCount() << " VPIOs." << endl;
+    }
 
-        i_vp++;
+    if ( printDebug ) [[unlikely]]
+    {
+        for ( Uint32 i = 0; i < frame.out_bins.size(); i++ )
+            cout << "Bin " << i << " size after all vps are finished: " << frame.out_bins[i].vpoos->size() << endl;
+        for ( Uint32 i = 0; i < frame.arenas.size(); i++ )
+            cout << "Frame arena " << i << " uses " << frame.arenas[i].GetUsedBytes() << " of "
+                 << frame.arenas[i].GetReservedBytes() << " bytes." << endl;
+    }
 
-        vp_threads.erase( it );
+    // Wait for rasterisers and then draw their surfaces
+    for ( auto& bin : frame.out_bins )
+    {
+        bin.vpoos->block_new();
     }
 
+    if ( pipelinedFrames )
+    {
+        // this frame is rasterised while the next one is submitted (see InitiateRendering).
+        // Draws go to the other frame from now on, which is the one rasterisers are busy with.
+        bool was_pending = raster_pending;
+        current_frame ^= 1;
+        raster_pending = true;
+        if ( !was_pending )
+            return false;
+    }
+    raster_pool->Wait();
+
+    if ( tile_scheduler != nullptr && printDebug ) [[unlikely]]
+        cout << "Rasteriser workers stole " << tile_scheduler->GetStolenTilesCount() << " tiles." << endl;
+
     if ( printDebug ) [[unlikely]]
-        cout << "out_vpoos queue size after all vps are finished: " << out_vpoos->size() << endl;
+    {
+        for ( Uint32 i_rr = 0; i_rr < rasterisers.size(); i_rr++ )
+        {
+            // mark origin of each rasteriser's surface
+            for ( Uint16 x = 0; x < 3; x++ )
+            {
+                w_window->drawPixel( rasterisers[i_rr]->x_begin + x, rasterisers[i_rr]->y_begin, (Uint32) 0xff00ffff );
+            }
+            cout << "h " << rasterisers[i_rr]->x_begin << " y " << rasterisers[i_rr]->y_begin << endl;
+        }
+    }
 
-    // Wait for rasterisers and then draw their surfaces
-    out_vpoos->block_new();
-    int i_rr = 0;
-    for ( auto it = rast_threads.begin(); it != rast_threads.end(); )
+    if ( tile_scheduler == nullptr )
+        RebalanceBands();
+
+    return true;
+}
+
+void Renderer::RebalanceBands()
+{
+    // Assumes that the work of each band was spread evenly across its rows. New borders are
+    // placed where the summed up work reaches equal shares. Borders only move half way towards
+    // that point so that a single unusual frame does not throw the split off.
+    const Uint16 min_height = Rasteriser::block_size;
+    const Uint16 frame_height = w_window->Getheight();
+    const size_t band_count = rasterisers.size();
+    if ( band_count < 2 || frame_height < band_count * min_height )
+        return;
+
+    double total_time = 0;
+    for ( const auto& rasteriser : rasterisers )
     {
-        rast_threads[0]->join(); // always 0 because we empty the queue and never skip an element
-        rast_threads.erase( it );
+        total_time += rasteriser->GetBusyTimeNs();
+    }
+    if ( total_time <= 0 )
+        return;
+
+    std::vector< Uint16 > borders( band_count + 1, 0 );
+    borders[ band_count ] = frame_height;
+    size_t band = 0;
+    double time_before_band = 0;
+    for ( size_t i = 1; i < band_count; i++ )
+    {
+        // find band in which the target share is reached
+        double target_time = total_time * i / band_count;
+        while ( band < band_count - 1 && time_before_band + rasterisers[band]->GetBusyTimeNs() < target_time )
+        {
+            time_before_band += rasterisers[band]->GetBusyTimeNs();
+            band++;
+        }
+
+        const Rasteriser& r = *rasterisers[band];
+        double band_time = std::max< double >( r.GetBusyTimeNs(), 1 );
+        double ideal_border = r.y_begin + ( r.y_end - r.y_begin ) * std::min( ( target_time - time_before_band ) / band_time, 1.0 );
+        int border = std::lround( ( rasterisers[i]->y_begin + ideal_border ) / 2 );
+
+        // keep bands at least min_height rows high
+        border = std::max< int >( border, borders[ i - 1 ] + min_height );
+        border = std::min< int >( border, frame_height - ( band_count - i ) * min_height );
+        borders[i] = border;
+    }
+
+    // Only the bins of the next frame move now. Vertex processors get them in InitiateRendering
+    // and rasterisers follow once they start on that frame (see StartRasterisers).
+    std::vector< VPOOBin >& out_bins = frames[ current_frame ].out_bins;
+    for ( size_t i = 0; i < band_count; i++ )
+    {
+        if ( out_bins[i].y_begin == borders[i] && out_bins[i].y_end == borders[ i + 1 ] )
+            continue;
+        out_bins[i].y_begin = borders[i];
+        out_bins[i].y_end   = borders[ i + 1 ];
+
+        if ( printDebug ) [[unlikely]]
+            cout << "Rasteriser " << i << " took " << rasterisers[i]->GetBusyTimeNs() / 1000 << " us. Moving to y_begin "
+                 << borders[i] << " and y_end " << borders[ i + 1 ] << endl;
+    }
+}
+
+void Renderer::SubmitVPIO( VPIO& vpio )
+{
+    vpio.sortTriangles = sortTriangles;
+    std::vector< shared_ptr< Texture > >& textures = frames[ current_frame ].textures;
+    if ( vpio.texture != nullptr && ( textures.empty() || textures.back() != vpio.texture ) )
+        textures.push_back( vpio.texture );
 
-        rasterisers[i_rr]->r_texture->t_pixels[0] = 0xff00ffff;
-        rasterisers[i_rr]->r_texture->t_pixels[1] = 0xff00ffff;
-        rasterisers[i_rr]->r_texture->t_pixels[2] = 0xff00ffff;
-        rasterisers[i_rr]->r_texture->t_pixels[500] = 0xff00ffff;
-        rasterisers[i_rr]->r_texture->t_pixels[501] = 0xff00ffff;
-        rasterisers[i_rr]->r_texture->t_pixels[502] = 0xff00ffff;
+    if ( sortFrontToBack )
+        sorted_vpios.push_back( vpio );
+    else
+        in_vpios->push_back( vpio );
+}
 
-        // copy to r_texture
-        SDL_Rect drect;
-        drect.x = 0;
-        drect.y = rasterisers[i_rr]->y_begin;
-        drect.w = 0;
-        drect.h = 0;
-        w_window->drawTexture( rasterisers[i_rr]->r_texture, drect );
+void Renderer::SubmitSortedVPIOs()
+{
+    // hands collected VPIOs to the vertex processors, nearest first. Then the
+    // z buffer (and hierarchical z buffer) reject as much as possible.
+    // Draws are all opaque for now so their order doesn't change the result.
+    if ( sorted_vpios.empty() )
+        return;
+
+    std::vector< std::pair< float, Uint32 > > keys;
+    keys.reserve( sorted_vpios.size() );
+    for ( Uint32 i = 0; i < sorted_vpios.size(); i++ )
+    {
+        keys.push_back( { GetNearestViewDepth( sorted_vpios[i] ), i } );
+    }
+    // stable so that draws at the same depth keep the order they were submitted in
+    std::stable_sort( keys.begin(), keys.end(), []( const auto& a, const auto& b ) { return a.first < b.first; } );
 
-        cout << "h " << drect.x << " y " << drect.y << endl;
+    for ( const auto& key : keys )
+    {
+        in_vpios->push_back( sorted_vpios[ key.second ] );
+    }
+    sorted_vpios.clear();
+}
 
-        i_rr++;
+float Renderer::GetNearestViewDepth( const VPIO& vpio ) const
+{
+    // view space depth of the nearest point of the mesh's bounding sphere
+    Matrix4f modelView = viewMatrix * vpio.objMatrix;
+    Vector3f center = vpio.mesh->GetBoundsCenter();
+    Vector4f viewCenter = modelView * Vector4f( center.x, center.y, center.z, 1 );
+
+    // objMatrix and viewMatrix may both scale the mesh. take the biggest scale of its axes in view space.
+    float scale = 0;
+    for ( int column = 0; column < 3; column++ )
+    {
+        Vector3f axis = Vector3f( modelView.at( column, 0 ), modelView.at( column, 1 ), modelView.at( column, 2 ) );
+        scale = std::max( scale, axis.length() );
     }
+
+    return viewCenter.z - vpio.mesh->GetBoundsRadius() * scale;
 }
 
 void Renderer::DrawDebugPlane( float z_value )
@@ -222,7 +468,7 @@ void Renderer::DrawDebugPlane( float z_value )
     colour.g = 0;
     colour.a = SDL_ALPHA_OPAQUE;
     // Generate 2 big triangles in perspective space that cover the screen with z = far_z.
-    // Then apply screenspace matrix to triangles and add to out_vpoos
+    // Then apply screenspace matrix to triangles and add to out_bins
     Triangle tri1, tri2;
 
     // manually set values of triangle verts
@@ -254,11 +500,17 @@ void Renderer::DrawDebugPlane( float z_value )
     bool tri1_handedness = triangleArea< float >( tri1.verts[0].posVec, tri1.verts[1].posVec, tri1.verts[2].posVec ) < 0;
     bool tri2_handedness = triangleArea< float >( tri2.verts[0].posVec, tri2.verts[1].posVec, tri2.verts[2].posVec ) < 0;
 
-    VPOO vpoo;
-    vpoo = VPOO( tri1.verts[0], tri1.verts[1], tri1.verts[2], tri1_handedness, colour );
-    out_vpoos->push_back( vpoo );
-    vpoo = VPOO( tri2.verts[0], tri2.verts[1], tri2.verts[2], tri2_handedness, colour );
-    out_vpoos->push_back( vpoo );
+    // plane covers the whole screen so every rasteriser needs it
+    VPOO vpoo1 = VPOO( tri1.verts[0], tri1.verts[1], tri1.verts[2], tri1_handedness, colour );
+    VPOO vpoo2 = VPOO( tri2.verts[0], tri2.verts[1], tri2.verts[2], tri2_handedness, colour );
+    vpoo1.CalculateSetup( !blockRasterisation );
+    vpoo2.CalculateSetup( !blockRasterisation );
+    FrameData& frame = frames[ current_frame ];
+    for ( auto& bin : frame.out_bins )
+    {
+        bin.vpoos->push_back( vpoo1, frame.arenas.back() );
+        bin.vpoos->push_back( vpoo2, frame.arenas.back() );
+    }
 }
 
 Renderer::~Renderer()
@@ -10,6 +10,8 @@
 #include "types/VertexProcessorObjs.h"
 #include "rendering/vertexprocessor.h"
 #include "rendering/rasteriser.h"
+#include "rendering/tilescheduler.h"
+#include "rendering/workerpool.h"
 #include "window/window.h"
 
 class Renderer
@@ -35,8 +37,11 @@ class Renderer
         void DrawMesh( const Matrix4f& objMat, shared_ptr<Mesh> mesh );
         void FillTriangle( const Vertexf& v1, const Vertexf& v2, const Vertexf& v3 );
         void FillTriangle( Triangle tris );
+        // InitiateRendering starts work on the frame that draws go to. WaitUntilFinished returns once
+        // that frame is drawn or, with pipelinedFrames, once the frame before it is drawn. It returns
+        // false if no frame was drawn yet (the first one with pipelinedFrames), so there is nothing to show.
 	void InitiateRendering();
-        void WaitUntilFinished();
+        bool WaitUntilFinished();
 
         // debug rendering functions
         void DrawFarPlane()  { DrawDebugPlane( far_z  ); }
@@ -52,17 +57,53 @@ class Renderer
         float far_z  = 1;
 
         shared_ptr< SafeDeque< VPIO > > in_vpios;
-        shared_ptr< SafeDeque< VPOO > > out_vpoos;
+        // with sortFrontToBack VPIOs are collected here and sorted once the frame is complete
+        std::vector< VPIO > sorted_vpios;
+        Uint16 out_bin_columns = 1;
+
+        // Everything that has to live from a frame's first draw until its rasterisers are done.
+        // With pipelinedFrames vertex processors fill one of them while rasterisers still
+        // draw the previous frame from the other one. Otherwise only frames[0] is used.
+        struct FrameData
+        {
+            std::vector< VPOOBin > out_bins; // one per rasteriser
+            // memory of triangles in the bins. one per vertex processor and the last one for the renderer itself.
+            // All are reset at once when the bins are cleared.
+            std::vector< FrameArena > arenas;
+            // triangles only borrow their texture (see VPOO), so the textures of the frame's draws are kept here
+            std::vector< shared_ptr< Texture > > textures;
+        };
+        FrameData frames[2];
+        Uint8 current_frame = 0; // index of the frame that draws go to
+        bool raster_pending = false; // only with pipelinedFrames. the other frame still has to be rasterised.
+        void StartRasterisers( FrameData& frame );
 
-        std::vector< shared_ptr< std::thread > > vp_threads;
-        std::vector< shared_ptr< std::thread > > rast_threads;
         std::vector< shared_ptr< VertexProcessor > > vertex_processors;
         std::vector< shared_ptr< Rasteriser > > rasterisers;
 
+        // only used with tiledRasterisation. rasterisers then draw one tile each
+        // and are run by raster_worker_count threads.
+        shared_ptr< TileScheduler > tile_scheduler = nullptr;
+        Uint8 raster_worker_count = 0;
+        void ProcessTiles( Uint8 worker );
+
+        // without tiledRasterisation, band borders get moved after each frame so that
+        // every rasteriser gets about the same amount of work in the next frame
+        void RebalanceBands();
+
         shared_ptr< Matrix4f > objMatrix = make_shared< Matrix4f >();
         Matrix4f viewMatrix = Matrix4f(), perspMatrix = Matrix4f(), screenMatrix = Matrix4f();
 
+        // threads that run vertex processors and rasterisers every frame. Declared
+        // last so that they are stopped before anything they work on is destroyed.
+        unique_ptr< WorkerPool > vp_pool = nullptr;
+        unique_ptr< WorkerPool > raster_pool = nullptr;
+
         void DrawDebugPlane( float z_value );
+
+        void SubmitVPIO( VPIO& vpio );
+        void SubmitSortedVPIOs();
+        float GetNearestViewDepth( const VPIO& vpio ) const;
 };
 
 #endif // RENDERER_H
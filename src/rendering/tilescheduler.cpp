@@ -0,0 +1,80 @@
+#include "tilescheduler.h"
+
+TileScheduler::TileScheduler( Uint16 tile_columns, Uint16 tile_rows, Uint8 worker_count )
+{
+    //ctor
+    for ( Uint32 i = 0; i < (Uint32) tile_columns * tile_rows; i++ )
+    {
+        tile_order.push_back( i );
+    }
+    std::sort( tile_order.begin(), tile_order.end(), [tile_columns]( Uint32 a, Uint32 b )
+    {
+        return GetMortonCode( a % tile_columns, a / tile_columns ) < GetMortonCode( b % tile_columns, b / tile_columns );
+    } );
+
+    for ( Uint8 i = 0; i < std::max< Uint8 >( worker_count, 1 ); i++ )
+    {
+        queues.push_back( make_unique< WorkerQueue >() );
+    }
+}
+
+void TileScheduler::Reset()
+{
+    // every worker gets a contiguous run of the Morton order
+    stolenTiles_count = 0;
+    size_t tile_count = tile_order.size();
+    for ( size_t i = 0; i < queues.size(); i++ )
+    {
+        std::lock_guard< std::mutex > lock( queues[i]->mutex );
+        queues[i]->tiles.assign( tile_order.begin() + tile_count * i / queues.size(),
+                                 tile_order.begin() + tile_count * ( i + 1 ) / queues.size() );
+    }
+}
+
+bool TileScheduler::NextTile( Uint8 worker, Uint32& tile_index )
+{
+    // own run first
+    {
+        WorkerQueue& own = *queues[ worker ];
+        std::lock_guard< std::mutex > lock( own.mutex );
+        if ( !own.tiles.empty() )
+        {
+            tile_index = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the end of the other runs as that is farthest from where their owners are working
+    for ( size_t i = 1; i < queues.size(); i++ )
+    {
+        WorkerQueue& victim = *queues[ ( worker + i ) % queues.size() ];
+        std::lock_guard< std::mutex > lock( victim.mutex );
+        if ( !victim.tiles.empty() )
+        {
+            tile_index = victim.tiles.back();
+            victim.tiles.pop_back();
+            stolenTiles_count++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Uint32 TileScheduler::GetMortonCode( Uint16 x, Uint16 y )
+{
+    // interleaves the bits of x and y
+    Uint32 code = 0;
+    for ( Uint8 bit = 0; bit < 16; bit++ )
+    {
+        code |= ( ( x >> bit ) & 1u ) << ( 2 * bit );
+        code |= ( ( y >> bit ) & 1u ) << ( 2 * bit + 1 );
+    }
+    return code;
+}
+
+TileScheduler::~TileScheduler()
+{
+    //dtor
+}
@@ -0,0 +1,43 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include "common.h"
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+class TileScheduler
+{
+    // Hands out tiles of the screen to rasteriser workers.
+    //
+    // Tiles are sorted in Morton order so that tiles that are processed one
+    // after another lie next to each other on screen. Every worker gets an
+    // even run of that order. Workers take tiles from the front of their own
+    // run and, once it is empty, steal from the back of the other runs.
+    // That way a worker that only got empty tiles helps out the ones that
+    // got all the geometry.
+    public:
+        TileScheduler( Uint16 tile_columns, Uint16 tile_rows, Uint8 worker_count );
+        virtual ~TileScheduler();
+
+        void Reset(); // deals out all tiles again. call before starting workers.
+        bool NextTile( Uint8 worker, Uint32& tile_index ); // false once all tiles are taken
+
+        Uint8 GetWorkerCount() const { return queues.size(); }
+        Uint32 GetStolenTilesCount() const { return stolenTiles_count; }
+
+    private:
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque< Uint32 > tiles;
+        };
+
+        std::vector< Uint32 > tile_order; // row-major tile indices in Morton order
+        std::vector< unique_ptr< WorkerQueue > > queues;
+        std::atomic< Uint32 > stolenTiles_count = 0;
+
+        static Uint32 GetMortonCode( Uint16 x, Uint16 y );
+};
+
+#endif // TILESCHEDULER_H
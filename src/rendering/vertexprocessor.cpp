@@ -1,25 +1,40 @@
 #include "vertexprocessor.h"
 
-VertexProcessor::VertexProcessor( shared_ptr< SafeDeque< VPIO > > in, shared_ptr< SafeDeque< VPOO > > out )
+VertexProcessor::VertexProcessor( shared_ptr< SafeDeque< VPIO > > in, const std::vector< VPOOBin >& out, FrameArena* arena, Uint16 out_columns )
 {
     this->in_vpios = in;
-    this->output_vpoos = out;
+    SetOutputBins( out, out_columns, arena );
+}
+
+void VertexProcessor::SetOutputBins( const std::vector< VPOOBin >& out, Uint16 out_columns, FrameArena* arena )
+{
+    output_bins = out;
+    output_bin_columns = out_columns;
+    frame_arena = arena;
+    bin_batches.resize( output_bins.size() );
 }
 
 void VertexProcessor::ProcessQueue()
 {
     processedVPIOs_count = 0;
-    unique_ptr< VPIO > current_vpio;
-    do
+    VPIO current_vpio;
+    while ( in_vpios->pop( current_vpio ) )
     {
-        current_vpio = in_vpios->pop();
-        if ( current_vpio )
-        {
-            ProcessMesh( *current_vpio );
-            processedVPIOs_count++;
-        }
+        ProcessMesh( current_vpio );
+        processedVPIOs_count++;
 
-    } while ( !in_vpios->blocked() );
+        // rasterisers can start on the mesh right away
+        for ( size_t i = 0; i < bin_batches.size(); i++ )
+            FlushBinBatch( i );
+    }
+}
+
+void VertexProcessor::FlushBinBatch( size_t bin )
+{
+    if ( bin_batches[ bin ].empty() )
+        return;
+    output_bins[ bin ].vpoos->push_back( bin_batches[ bin ].data(), bin_batches[ bin ].size(), *frame_arena );
+    bin_batches[ bin ].clear();
 }
 
 void VertexProcessor::ProcessMesh( const VPIO& current_vpio )
@@ -29,18 +44,70 @@ void VertexProcessor::ProcessMesh( const VPIO& current_vpio )
     // calculate mesh matrix
     Matrix4f transMatrix = perspMatrix * viewMatrix * current_vpio.objMatrix;
 
+    if ( current_vpio.sortTriangles && current_vpio.mesh->GetTriangleCount() > 1 )
+    {
+        SortTriangles( *current_vpio.mesh, viewMatrix * current_vpio.objMatrix );
+        for ( Uint32 i : triangle_order )
+        {
+            ProcessTriangle( current_vpio.mesh->GetTriangle( i ), transMatrix, current_vpio.colour, current_vpio.texture.get() );
+        }
+        return;
+    }
+
     for ( Uint32 i = 0; i < current_vpio.mesh->GetTriangleCount(); i++ )
     {
-        ProcessTriangle( current_vpio.mesh->GetTriangle( i ), transMatrix, current_vpio.colour, current_vpio.texture );
+        ProcessTriangle( current_vpio.mesh->GetTriangle( i ), transMatrix, current_vpio.colour, current_vpio.texture.get() );
+    }
+}
+
+void VertexProcessor::SortTriangles( const Mesh& mesh, const Matrix4f& modelView )
+{
+    // Bucket sorts triangles by the view space depth of their first vertex into triangle_order.
+    // This is only meant to be rough, so that most triangles that hide others come first.
+    Uint32 triangle_count = mesh.GetTriangleCount();
+    triangle_depths.resize( triangle_count );
+    triangle_order.resize( triangle_count );
+    bucket_offsets.assign( triangle_sort_buckets + 1, 0 );
+
+    float depth_min = std::numeric_limits< float >::max();
+    float depth_max = std::numeric_limits< float >::lowest();
+    for ( Uint32 i = 0; i < triangle_count; i++ )
+    {
+        Vector4f pos = mesh.GetVertex( mesh.GetIndex( 3 * i ) ).posVec;
+        // only the z row of the matrix is needed
+        triangle_depths[i] = modelView.at( 0, 2 ) * pos.x + modelView.at( 1, 2 ) * pos.y +
+                             modelView.at( 2, 2 ) * pos.z + modelView.at( 3, 2 ) * pos.w;
+        depth_min = std::min( depth_min, triangle_depths[i] );
+        depth_max = std::max( depth_max, triangle_depths[i] );
+    }
+
+    // count triangles per bucket, turn counts into offsets, then place triangles
+    float bucket_scale = depth_max > depth_min ? ( triangle_sort_buckets - 1 ) / ( depth_max - depth_min ) : 0;
+    for ( Uint32 i = 0; i < triangle_count; i++ )
+    {
+        triangle_depths[i] = ( triangle_depths[i] - depth_min ) * bucket_scale;
+        bucket_offsets[ (Uint32) triangle_depths[i] + 1 ]++;
+    }
+    for ( Uint16 bucket = 1; bucket <= triangle_sort_buckets; bucket++ )
+    {
+        bucket_offsets[ bucket ] += bucket_offsets[ bucket - 1 ];
+    }
+    for ( Uint32 i = 0; i < triangle_count; i++ )
+    {
+        triangle_order[ bucket_offsets[ (Uint32) triangle_depths[i] ]++ ] = i;
     }
 }
 
-void VertexProcessor::ProcessTriangle( const Triangle& tri, const Matrix4f& mat, SDL_Color colour, shared_ptr< Texture > tex )
+void VertexProcessor::ProcessTriangle( const Triangle& tri, const Matrix4f& mat, SDL_Color colour, const Texture* tex )
 {
-    std::vector< Vertexf > tri_verts = { tri.verts[0], tri.verts[1], tri.verts[2] };
-    tri_verts[0].posVec = mat * tri_verts[0].posVec;
-    tri_verts[1].posVec = mat * tri_verts[1].posVec;
-    tri_verts[2].posVec = mat * tri_verts[2].posVec;
+    ClipPolygon& polygon = tri_polygon;
+    Vertexf* tri_verts = polygon.verts;
+    polygon.count = 3;
+    for ( uint_fast8_t i = 0; i < 3; i++ )
+    {
+        tri_verts[i] = tri.verts[i];
+        tri_verts[i].posVec = mat * tri_verts[i].posVec;
+    }
    
     // cull triangle earlier if all posVec.w are outside of frustum
     bool cull_early = true;
@@ -54,6 +121,21 @@ void VertexProcessor::ProcessTriangle( const Triangle& tri, const Matrix4f& mat,
             break;
         }
     }
+    if ( cull_early && Do_VP_Clipping )
+    {
+        // big triangles (e.g. floors) can cover the frustum without any vertex inside of it.
+        // These are only culled if all of their vertices are outside of the same plane.
+        cull_early = false;
+        for ( uint_fast8_t c = 0; c < 3 && !cull_early; c++ )
+        {
+            for ( float factor : { 1.0f, -1.0f } )
+            {
+                cull_early = cull_early || ( tri_verts[0].GetPosVecComponent( c ) * factor > tri_verts[0].posVec.w &&
+                                             tri_verts[1].GetPosVecComponent( c ) * factor > tri_verts[1].posVec.w &&
+                                             tri_verts[2].GetPosVecComponent( c ) * factor > tri_verts[2].posVec.w );
+            }
+        }
+    }
     if ( cull_early )
     {
         if ( printDebug ) [[unlikely]]
@@ -77,14 +159,14 @@ void VertexProcessor::ProcessTriangle( const Triangle& tri, const Matrix4f& mat,
         }
 
         if ( clipping_required )
-            ClipTriangle( tri_verts );
+            ClipTriangle( polygon );
     }
 
-    if ( tri_verts.size() <= 0 )
+    if ( polygon.count < 3 )
         return;
 
     // prepare verts for rasterisation
-    for ( uint_fast8_t i = 0; i < 3; i++ )
+    for ( uint_fast8_t i = 0; i < polygon.count; i++ )
     {
         tri_verts[i].posVec = screenMatrix * tri_verts[i].posVec;
         // -- Screen Space
@@ -93,7 +175,7 @@ void VertexProcessor::ProcessTriangle( const Triangle& tri, const Matrix4f& mat,
 
     // It is possible that we end up with more than 3 vertices after clipping. so we have to create more than 1 triangle. we can create these new triangles
     // by assuming that all triangles share at least one vertices.
-    for ( uint_fast8_t i = 0; i <= tri_verts.size() - 3; i++ )
+    for ( uint_fast8_t i = 0; i + 2 < polygon.count; i++ )
     {
         // TODO backface culling based on normal vector
 
@@ -102,45 +184,89 @@ void VertexProcessor::ProcessTriangle( const Triangle& tri, const Matrix4f& mat,
         // true if right handed (and hence area bigger than 0)
         bool handedness = area < 0;
 
-        /*
-        // cull tiny triangle that probably wont affect the final result
-        if ( abs( area ) < 0.1 )
+        // degenerate triangles cover no pixels and have no gradients
+        if ( area == 0 )
             continue;
-        */
 
-        VPOO vpoo = VPOO( tri_verts[i], tri_verts[i+1], tri_verts[i+2],
+        VPOO vpoo = VPOO( tri_verts[0], tri_verts[i+1], tri_verts[i+2],
                                            handedness, tex, colour );
-        output_vpoos->push_back( vpoo );
+
+        // range of pixel centres the triangle may cover (exclusive). widened by the distance
+        // vertices can move when rasterisers snap them to fixed point.
+        const float snap = 1.0f / FixedEdge::subpixel_steps;
+        int y_start = std::ceil( vpoo.tris_verts[0].posVec.y - snap );
+        int y_stop  = std::ceil( vpoo.tris_verts[2].posVec.y + snap );
+        int x_start = std::ceil( std::min( { vpoo.tris_verts[0].posVec.x, vpoo.tris_verts[1].posVec.x, vpoo.tris_verts[2].posVec.x } ) - snap );
+        int x_stop  = std::ceil( std::max( { vpoo.tris_verts[0].posVec.x, vpoo.tris_verts[1].posVec.x, vpoo.tris_verts[2].posVec.x } ) + snap );
+
+        // tiny triangles that fall in between pixel centres cover nothing
+        if ( x_start >= x_stop || y_start >= y_stop )
+            continue;
+
+        vpoo.isSmall = x_stop - x_start <= small_triangle_size && y_stop - y_start <= small_triangle_size;
+        vpoo.CalculateSetup( !blockRasterisation && !vpoo.isSmall );
+        BinVPOO( vpoo );
+    }
+}
+
+void VertexProcessor::BinVPOO( VPOO& vpoo )
+{
+    // add triangle to the bins of all rasterisers whose area its bounding box covers.
+    // pixels are covered from ceil( min ) up to ceil( max ) (exclusive) due to our top-left fill convention.
+    // The box is widened to whole pixels so that it still holds after rasterisers snapped
+    // vertices to fixed point.
+    int y_start = std::floor( vpoo.tris_verts[0].posVec.y );
+    int y_stop  = std::floor( vpoo.tris_verts[2].posVec.y ) + 1;
+    int x_start = std::floor( std::min( { vpoo.tris_verts[0].posVec.x, vpoo.tris_verts[1].posVec.x, vpoo.tris_verts[2].posVec.x } ) );
+    int x_stop  = std::floor( std::max( { vpoo.tris_verts[0].posVec.x, vpoo.tris_verts[1].posVec.x, vpoo.tris_verts[2].posVec.x } ) ) + 1;
+
+    for ( size_t row = 0; row < output_bins.size(); row += output_bin_columns )
+    {
+        if ( output_bins[row].y_begin >= y_stop )
+            break;
+        if ( y_start >= output_bins[row].y_end )
+            continue;
+
+        for ( size_t i = row; i < row + output_bin_columns; i++ )
+        {
+            if ( output_bins[i].x_begin >= x_stop )
+                break;
+            if ( x_start < output_bins[i].x_end )
+            {
+                bin_batches[i].push_back( vpoo );
+                if ( bin_batches[i].size() >= bin_batch_size )
+                    FlushBinBatch( i );
+            }
+        }
     }
 }
 
-void VertexProcessor::ClipTriangle( std::vector< Vertexf >& result_vertices )
+void VertexProcessor::ClipTriangle( ClipPolygon& polygon )
 {
-    ClipPolygonAxis( result_vertices, 0);
-    ClipPolygonAxis( result_vertices, 1);
-    ClipPolygonAxis( result_vertices, 2);
+    ClipPolygonAxis( polygon, 0);
+    ClipPolygonAxis( polygon, 1);
+    ClipPolygonAxis( polygon, 2);
 }
 
-void VertexProcessor::ClipPolygonAxis( std::vector<Vertexf>& vertices, uint_fast8_t componentIndex )
+void VertexProcessor::ClipPolygonAxis( ClipPolygon& polygon, uint_fast8_t componentIndex )
 {
     // clips all vertices of a certain axis. results overwrite existing vertices
-    std::vector<Vertexf> result_temp; // like vertices has to be passed by reference
-    result_temp.clear();
+    clip_temp.count = 0;
 
     // clip against w=1
-    ClipPolygonComponent( vertices, componentIndex, 1.0f, result_temp );
-    vertices.clear();
+    ClipPolygonComponent( polygon, componentIndex, 1.0f, clip_temp );
+    polygon.count = 0;
 
     // clip against w=-1
-    ClipPolygonComponent( result_temp, componentIndex, -1.0f, vertices );
-    result_temp.clear();
+    ClipPolygonComponent( clip_temp, componentIndex, -1.0f, polygon );
 }
 
-void VertexProcessor::ClipPolygonComponent( const std::vector<Vertexf>& vertices, uint_fast8_t componentIndex, float componentFactor, std::vector<Vertexf>& result )
+void VertexProcessor::ClipPolygonComponent( const ClipPolygon& polygon, uint_fast8_t componentIndex, float componentFactor, ClipPolygon& result )
 {
     // iterate over each vertex and do one dimensional lerping
 
-    if ( vertices.size() <= 0 )
+    const Vertexf* vertices = polygon.verts;
+    if ( polygon.count <= 0 )
     {
         if ( printDebug ) [[unlikely]]
             cout << "There were no verts left for component " << (int) componentIndex << "!" << endl;
@@ -149,21 +275,21 @@ void VertexProcessor::ClipPolygonComponent( const std::vector<Vertexf>& vertices
     }
 
     // for the initial component comparison we just take the last one in the list
-    uint_fast8_t previousVertex = vertices.size() - 1;
-    float previousComponent = vertices.at( previousVertex ).GetPosVecComponent( componentIndex ) * componentFactor;
-    bool previousInside = previousComponent <= vertices.at( previousVertex ).posVec.w;
+    uint_fast8_t previousVertex = polygon.count - 1;
+    float previousComponent = vertices[ previousVertex ].GetPosVecComponent( componentIndex ) * componentFactor;
+    bool previousInside = previousComponent <= vertices[ previousVertex ].posVec.w;
 
-    for ( uint_fast8_t i = 0; i < vertices.size(); i++ )
+    for ( uint_fast8_t i = 0; i < polygon.count; i++ )
     {
-        float currentComponent = vertices.at( i ).GetPosVecComponent( componentIndex ) * componentFactor;
+        float currentComponent = vertices[ i ].GetPosVecComponent( componentIndex ) * componentFactor;
 
         // currentComponent gets inverted if componentFactor is negativ. Hence only <= is required.
-        bool currentInside = currentComponent <= vertices.at( i ).posVec.w;
+        bool currentInside = currentComponent <= vertices[ i ].posVec.w;
 
         /* 
         if ( printDebug && componentIndex > 0 ) [[unlikely]]
             cout << "Vertex with index " << (int) i << " for component " << (int) componentIndex
-                 << " has w of " << vertices.at( i ).posVec.w << " compared to currentComponent " << currentComponent 
+                 << " has w of " << vertices[ i ].posVec.w << " compared to currentComponent " << currentComponent 
                  << ". Hence inside: " << currentInside << endl;
         */
 
@@ -171,14 +297,14 @@ void VertexProcessor::ClipPolygonComponent( const std::vector<Vertexf>& vertices
         // (or the over way around)
         if ( currentInside ^ previousInside )
         {
-            float lerp = ( vertices.at( previousVertex ).posVec.w - previousComponent ) /
-                         ( ( vertices.at( previousVertex ).posVec.w - previousComponent ) -
-                           ( vertices.at( i ).posVec.w - currentComponent ) );
-            result.push_back( vertices.at( previousVertex ).lerp_new( vertices.at( i ), lerp ) );
+            float lerp = ( vertices[ previousVertex ].posVec.w - previousComponent ) /
+                         ( ( vertices[ previousVertex ].posVec.w - previousComponent ) -
+                           ( vertices[ i ].posVec.w - currentComponent ) );
+            result.push_back( vertices[ previousVertex ].lerp_new( vertices[ i ], lerp ) );
         }
 
         if ( currentInside )
-            result.push_back( vertices.at( i ) );
+            result.push_back( vertices[ i ] );
 
         previousVertex = i;
         previousComponent = currentComponent;
@@ -4,31 +4,69 @@
 #include "common.h"
 #include "types/Vertex.h"
 #include "types/Triangle.h"
+#include "types/FixedEdge.h"
 #include "types/VertexProcessorObjs.h"
 #include "types/SafeDeque.h"
+#include "types/FrameArena.h"
 
 class VertexProcessor
 {
     public:
-        VertexProcessor( shared_ptr< SafeDeque< VPIO > > in, shared_ptr< SafeDeque< VPOO > > out );
+        VertexProcessor( shared_ptr< SafeDeque< VPIO > > in, const std::vector< VPOOBin >& out, FrameArena* arena, Uint16 out_columns = 1 );
         virtual ~VertexProcessor();
 
-        shared_ptr< std::thread > ProcessQueueAsThread() { return make_shared< std::thread >( &VertexProcessor::ProcessQueue, this ); }
         void ProcessQueue();
         Uint32 GetProcessedVPIOsCount() const { return processedVPIOs_count; }
+        // not thread safe, only call in between frames
+        void SetOutputBins( const std::vector< VPOOBin >& out, Uint16 out_columns, FrameArena* arena );
 
         Matrix4f viewMatrix, perspMatrix, screenMatrix;
 
     private:
         shared_ptr< SafeDeque< VPIO > > in_vpios;
-        shared_ptr< SafeDeque< VPOO > > output_vpoos;
+        std::vector< VPOOBin > output_bins; // one per rasteriser. grid of output_bin_columns columns, stored row by row
+        Uint16 output_bin_columns = 1;
+        FrameArena* frame_arena; // bins take memory for our triangles from here. owned and reset by the renderer.
+
+        // triangles are handed to the bins in batches so that vertex processors
+        // rarely contend for the same bin. Kept around to avoid reallocations.
+        static const Uint8 bin_batch_size = 32;
+        std::vector< std::vector< VPOO > > bin_batches;
+        void FlushBinBatch( size_t bin );
+
+        // coarse front to back order of the current mesh's triangles. kept around to avoid reallocations.
+        static const Uint16 triangle_sort_buckets = 64;
+        std::vector< Uint32 > triangle_order;
+        std::vector< float > triangle_depths;
+        std::vector< Uint32 > bucket_offsets;
+
+        // triangles whose bounding box spans at most this many pixels in x and y are small (see VPOO)
+        static const Uint8 small_triangle_size = 8;
 
         Uint32 processedVPIOs_count = 0;
         void ProcessMesh( const VPIO& current_vpio );
-        void ProcessTriangle( const Triangle& tri, const Matrix4f& mat, SDL_Color colour, shared_ptr< Texture > tex );
-        void ClipTriangle( std::vector< Vertexf >& result_vertices );
-        void ClipPolygonAxis( std::vector<Vertexf>& vertices, uint_fast8_t componentIndex );
-        void ClipPolygonComponent( const std::vector<Vertexf>& vertices, uint_fast8_t componentIndex, float componentFactor, std::vector<Vertexf>& result );
+        void SortTriangles( const Mesh& mesh, const Matrix4f& modelView );
+        // Vertices of a triangle while it is clipped. Every clipping plane adds at most one
+        // vertex, so they fit in a fixed array and no triangle needs a heap allocation.
+        struct ClipPolygon
+        {
+            static const Uint8 max_vertices = 3 + 6;
+            Vertexf verts[ max_vertices ];
+            Uint8 count = 0;
+
+            inline void push_back( const Vertexf& vert )
+            {
+                assert( count < max_vertices );
+                verts[ count++ ] = vert;
+            }
+        };
+        ClipPolygon tri_polygon, clip_temp; // kept around so that their vertices aren't constructed per triangle
+
+        void ProcessTriangle( const Triangle& tri, const Matrix4f& mat, SDL_Color colour, const Texture* tex );
+        void BinVPOO( VPOO& vpoo );
+        void ClipTriangle( ClipPolygon& polygon );
+        void ClipPolygonAxis( ClipPolygon& polygon, uint_fast8_t componentIndex );
+        void ClipPolygonComponent( const ClipPolygon& polygon, uint_fast8_t componentIndex, float componentFactor, ClipPolygon& result );
 };
 
 #endif // VERTEXPROCESSOR_H
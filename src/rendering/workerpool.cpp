@@ -0,0 +1,66 @@
+#include "workerpool.h"
+
+WorkerPool::WorkerPool( Uint8 worker_count, std::function< void( Uint8 ) > job )
+{
+    //ctor
+    this->job = job;
+    for ( Uint8 i = 0; i < worker_count; i++ )
+    {
+        workers.emplace_back( &WorkerPool::Work, this, i );
+    }
+}
+
+void WorkerPool::Start()
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        busy_count = workers.size();
+        round++;
+    }
+    cond_start.notify_all();
+}
+
+void WorkerPool::Wait()
+{
+    std::unique_lock< std::mutex > lock( mutex );
+    cond_done.wait( lock, [this]() { return busy_count == 0; } );
+}
+
+void WorkerPool::Work( Uint8 worker )
+{
+    Uint32 last_round = 0;
+    while ( true )
+    {
+        {
+            std::unique_lock< std::mutex > lock( mutex );
+            cond_start.wait( lock, [this, last_round]() { return round != last_round || stopping; } );
+            if ( stopping )
+                return;
+            last_round = round;
+        }
+
+        job( worker );
+
+        bool last_one;
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            last_one = --busy_count == 0;
+        }
+        if ( last_one )
+            cond_done.notify_all();
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    //dtor
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        stopping = true;
+    }
+    cond_start.notify_all();
+    for ( auto& worker : workers )
+    {
+        worker.join();
+    }
+}
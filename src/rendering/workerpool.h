@@ -0,0 +1,41 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include "common.h"
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+class WorkerPool
+{
+    // Threads that are created once and then run a job for every call of Start().
+    //
+    // In between they sleep on a condition variable. Hence frames don't pay for
+    // creating and joining threads, and every worker keeps running on the same
+    // thread (and likely the same core) from frame to frame.
+    // Each worker calls job with its index. Wait() returns once all of them
+    // finished the job of the last Start().
+    public:
+        WorkerPool( Uint8 worker_count, std::function< void( Uint8 ) > job );
+        virtual ~WorkerPool();
+
+        void Start(); // wakes up all workers. call Wait() before starting again.
+        void Wait();
+
+        Uint8 GetWorkerCount() const { return workers.size(); }
+
+    private:
+        std::function< void( Uint8 ) > job;
+        std::vector< std::thread > workers;
+
+        std::mutex mutex;
+        std::condition_variable cond_start;
+        std::condition_variable cond_done;
+        Uint32 round = 0; // counts calls of Start()
+        Uint8 busy_count = 0; // workers that did not finish the current round yet
+        bool stopping = false;
+
+        void Work( Uint8 worker );
+};
+
+#endif // WORKERPOOL_H
@@ -0,0 +1,164 @@
+#ifndef APPENDLOG_H
+#define APPENDLOG_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include "types/FrameArena.h"
+
+template< class T >
+class AppendLog
+{
+    // Append-only list that producers add to in batches while a single reader
+    // walks it with a Cursor. Elements stay until clear(), so the reader can walk
+    // the list again (the depth prepass needs all triangles twice).
+    //
+    // Elements live in chunks that never move. Producers copy a batch while
+    // holding the mutex and then publish the new size with a release store.
+    // Hence the reader doesn't lock anything until it caught up with the
+    // producers, and producers only contend once per batch.
+    //
+    // Chunks come from the FrameArena of the producer that needed them and double
+    // in size up to max_chunk_size, so that lists with few elements stay small.
+    // clear() just forgets them. The arenas have to be reset after all logs using them were cleared.
+
+    static_assert( std::is_trivially_destructible_v< T >, "elements are dropped without destructing them" );
+
+    struct Chunk
+    {
+        T* items = nullptr;
+        size_t capacity = 0;
+        Chunk* next = nullptr;
+    };
+
+public:
+    static const size_t first_chunk_size = 16;
+    static const size_t max_chunk_size = 512;
+
+    struct Cursor
+    {
+        size_t index = 0;
+        size_t offset = 0; // within chunk
+        Chunk* chunk = nullptr;
+    };
+
+    AppendLog() {}
+    AppendLog( const AppendLog& ) = delete;
+    AppendLog& operator=( const AppendLog& ) = delete;
+
+    inline size_t size() const
+    {
+        return published.load( std::memory_order_acquire );
+    }
+
+    void push_back( const T* objs, size_t count, FrameArena& arena )
+    {
+        // copies count elements behind the published ones and publishes them at once
+        std::lock_guard< std::mutex > lock( mutex );
+        size_t copied = 0;
+        while ( copied < count )
+        {
+            if ( tail == nullptr || tail_count == tail->capacity )
+                AddChunk( arena );
+            size_t n = std::min( count - copied, tail->capacity - tail_count );
+            std::uninitialized_copy_n( objs + copied, n, tail->items + tail_count );
+            tail_count += n;
+            copied += n;
+        }
+        published.store( published.load( std::memory_order_relaxed ) + count, std::memory_order_release );
+
+        if ( reader_waiting )
+            cond_mod.notify_all();
+    }
+
+    inline void push_back( const T& obj, FrameArena& arena )
+    {
+        push_back( &obj, 1, arena );
+    }
+
+    inline Cursor begin() const
+    {
+        // the first chunk may not exist yet. next() picks it up once it is published.
+        return Cursor();
+    }
+
+    const T* next( Cursor& cursor )
+    {
+        // Returns the element at cursor and moves it on. Waits if producers didn't
+        // publish it yet. Returns nullptr once all elements are read and new ones are blocked.
+        if ( cursor.index >= published.load( std::memory_order_acquire ) ) [[unlikely]]
+        {
+            std::unique_lock< std::mutex > lock( mutex );
+            reader_waiting = true;
+            while ( cursor.index >= published.load( std::memory_order_relaxed ) && !new_blocked )
+                cond_mod.wait( lock );
+            reader_waiting = false;
+            if ( cursor.index >= published.load( std::memory_order_relaxed ) )
+                return nullptr;
+        }
+
+        // chunks were linked before the element got published
+        if ( cursor.chunk == nullptr )
+        {
+            cursor.chunk = head;
+        }
+        else if ( cursor.offset == cursor.chunk->capacity )
+        {
+            cursor.chunk = cursor.chunk->next;
+            cursor.offset = 0;
+        }
+        cursor.index++;
+        return &cursor.chunk->items[ cursor.offset++ ];
+    }
+
+    void clear()
+    {
+        // drops all elements. their memory goes back with the next reset of the arenas.
+        std::lock_guard< std::mutex > lock( mutex );
+        published.store( 0, std::memory_order_release );
+        head = tail = nullptr;
+        tail_count = 0;
+    }
+
+    void block_new()
+    {
+        // tells the reader that no more elements will follow
+        std::lock_guard< std::mutex > lock( mutex );
+        new_blocked = true;
+        cond_mod.notify_all();
+    }
+
+    inline void unblock_new()
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        new_blocked = false;
+    }
+
+private:
+    Chunk* head = nullptr;
+    Chunk* tail = nullptr;
+    size_t tail_count = 0; // elements in tail
+    std::atomic< size_t > published = 0;
+
+    bool new_blocked = false;
+    bool reader_waiting = false;
+    std::mutex mutex;
+    std::condition_variable cond_mod;
+
+    void AddChunk( FrameArena& arena )
+    {
+        Chunk* chunk = arena.Create< Chunk >();
+        chunk->capacity = tail == nullptr ? first_chunk_size : std::min( tail->capacity * 2, max_chunk_size );
+        chunk->items = static_cast< T* >( arena.Allocate( chunk->capacity * sizeof( T ), alignof( T ) ) );
+
+        if ( tail == nullptr )
+            head = chunk;
+        else
+            tail->next = chunk;
+        tail = chunk;
+        tail_count = 0;
+    }
+};
+
+#endif // APPENDLOG_H
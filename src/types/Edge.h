@@ -9,52 +9,41 @@ template< typename T >
 class Edge
 {
     // Represents a triangle edge. used for rasterisation.
-    // You can walk along the y axis by using DoYStep() or GoToStep().
-    // For each Y coordinate you can get your current X coord, texel coords, and depth
+    // You can walk along the y axis by using DoYStep().
+    // For each Y coordinate you can get your current X coord and attributes (see Vertex.h)
+    //
+    // Edges only keep what they need for stepping, so they are cheap to copy
+    // (see TriangleSetup).
 
     public:
-        Edge( const Vertex<T>& vertMin, const Vertex<T>& vertMax, const TexCoordsForEdge<T>& texcoordsforedge, int vertMin_Index );
-        virtual ~Edge();
+        Edge() {}
+        Edge( const Vertex<T>& vertMin, const Vertex<T>& vertMax, const TexCoordsForEdge<T>& texcoords, int vertMin_Index );
+        ~Edge() = default; // trivial, so that triangles can live in a FrameArena
 
         // getters
         inline T GetYStart()   const { return yStart;   }
         inline T GetYEnd()     const { return yEnd;     }
         inline T GetCurrentX() const { return currentX; }
-        inline T GetCurrentTexCoordX() const { return texCoord_currentX; }
-        inline T GetCurrentTexCoordY() const { return texCoord_currentY; }
-        inline T GetCurrentOneOverZ() const { return texCoord_currentOneOverZ; }
-        inline T GetCurrentDepth() const { return currentDepth; }
+        inline T GetCurrent( Uint8 attribute ) const { return current[attribute]; }
 
         // functions
         void DoYStep(); // add xStep to currentX
-        void GoToStep( int newY ); // set currentX to new Y (start is 0)
 
     protected:
         //-- runtime vars
 
         // pixel x and steps
-        T currentX;
-        T xStep;
-        // texcoord x/y and steps
-        T texCoord_currentX;
-        T texCoordX_step;
-        T texCoord_currentY;
-        T texCoordY_step;
-        T texCoord_currentOneOverZ;
-        T texCoord_OneOverZ_step; // used for perspective correction
-        T currentDepth; // used for depth testing
-        T depth_step;
+        T currentX = 0;
+        T xStep = 0;
+        // attributes and their steps
+        T current[attribute_count] = {};
+        T steps[attribute_count] = {};
 
-        T yPrestep;
+        int yStart = 0;
+        int yEnd = 0;
 
-        //-- constructor vars
-        Vertex<T> vertMini;
-        Vertex<T> vertMidi;
-        Vertex<T> vertMaxi;
-        TexCoordsForEdge<T> texcoords;
-        int vertMini_Index;
-        int yStart;
-        int yEnd;
+        // set current values to new Y (start is 0)
+        void GoToStep( int newY, T yPrestep, const Vertex<T>& vertMin, const TexCoordsForEdge<T>& texcoords, int vertMin_Index );
 };
 
 typedef Edge< float > Edgef;
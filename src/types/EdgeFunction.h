@@ -0,0 +1,74 @@
+#ifndef EDGEFUNCTION_H
+#define EDGEFUNCTION_H
+
+#include "common.h"
+
+template< typename T >
+struct EdgeFunction
+{
+    // Half-space function of a directed triangle edge. Used by the block rasteriser.
+    // Evaluates to the distance from the edge times the edge's length. Values are
+    // positive for points on the inside of the edge if the triangle is wound so that
+    // its signed area is positive.
+    //
+    // Points exactly on the edge only count as covered for top and left edges.
+    // This matches the top-left fill convention of the scanline rasteriser.
+
+    T xStep = 0; // change of value per pixel in x
+    T yStep = 0; // change of value per pixel in y
+    T originX = 0, originY = 0;
+    bool isTopLeft = false;
+
+    EdgeFunction() {}
+    EdgeFunction( const Vector4<T>& from, const Vector4<T>& to )
+    {
+        T dX = to.x - from.x;
+        T dY = to.y - from.y;
+
+        xStep = -dY;
+        yStep = dX;
+        originX = from.x;
+        originY = from.y;
+
+        // screen y points downwards. Hence edges going up are left edges
+        // and horizontal edges going right are top edges.
+        isTopLeft = dY < 0 || ( dY == 0 && dX > 0 );
+    }
+
+    inline T Evaluate( const T& x, const T& y ) const
+    {
+        return xStep * ( x - originX ) + yStep * ( y - originY );
+    }
+
+    inline bool IsInside( const T& value ) const
+    {
+        return value > 0 || ( value == 0 && isTopLeft );
+    }
+
+    // biggest value found on a size x size block of pixels starting at x, y
+    inline T GetBlockMax( const T& x, const T& y, const T& size ) const
+    {
+        return Evaluate( x, y ) + std::max< T >( xStep * ( size - 1 ), 0 ) +
+                                  std::max< T >( yStep * ( size - 1 ), 0 );
+    }
+
+    // smallest value found on a size x size block of pixels starting at x, y
+    inline T GetBlockMin( const T& x, const T& y, const T& size ) const
+    {
+        return Evaluate( x, y ) + std::min< T >( xStep * ( size - 1 ), 0 ) +
+                                  std::min< T >( yStep * ( size - 1 ), 0 );
+    }
+
+    // true if all pixels of the block are further inside than margin pixels. The margin
+    // covers rounding differences to evaluating pixels one by one.
+    inline bool IsBlockInside( const T& x, const T& y, const T& size, const T& margin ) const
+    {
+        // |xStep| + |yStep| is at least the length of the edge, so this never underestimates the margin
+        return GetBlockMin( x, y, size ) > margin * ( std::abs( xStep ) + std::abs( yStep ) );
+    }
+};
+
+typedef EdgeFunction< float > EdgeFunctionf;
+typedef EdgeFunction< double > EdgeFunctiond;
+
+#endif // EDGEFUNCTION_H
@@ -0,0 +1,97 @@
+#ifndef FIXEDEDGE_H
+#define FIXEDEDGE_H
+
+#include "common.h"
+
+struct FixedEdge
+{
+    // Triangle edge with its end points snapped to 28.4 fixed point. Used by the
+    // fixed point scanline rasteriser.
+    //
+    // currentX is always exactly ceil() of the x at which the edge crosses the
+    // current scanline. It is stepped with integers only by keeping track of the
+    // remainder of that division, so it never drifts and any scanline can be
+    // jumped to directly. Together with ceil on y this gives an exact top-left
+    // fill convention.
+
+    static const int subpixel_bits  = 4;
+    static const int subpixel_steps = 1 << subpixel_bits;
+
+    int yStart = 0, yEnd = 0; // first and last (exclusive) scanline
+    int currentY = 0;
+    int currentX = 0;
+
+    FixedEdge() {}
+    FixedEdge( Sint64 fromX, Sint64 fromY, Sint64 toX, Sint64 toY )
+    {
+        // expects 28.4 coordinates with fromY <= toY
+        originX = fromX;
+        originY = fromY;
+        dX = toX - fromX;
+        dY = toY - fromY;
+
+        yStart = CeilDiv( fromY, subpixel_steps );
+        yEnd   = CeilDiv( toY,   subpixel_steps );
+
+        // x changes by dX / dY for each subpixel step in y. Split up a whole
+        // pixel of that into integer and fractional part of the denominator.
+        denominator = dY * subpixel_steps;
+        if ( denominator != 0 )
+        {
+            Sint64 change = dX * subpixel_steps;
+            xStep = FloorDiv( change, denominator );
+            remainderStep = change - xStep * denominator;
+        }
+
+        GoToY( yStart );
+    }
+
+    // snaps a screen coordinate to 28.4
+    static inline Sint64 ToFixed( float value ) { return std::llround( value * subpixel_steps ); }
+
+    inline void GoToY( int y )
+    {
+        currentY = y;
+        if ( denominator == 0 )
+        {
+            currentX = CeilDiv( originX, subpixel_steps );
+            return;
+        }
+
+        // x = ceil( numerator / denominator ) while numerator = x * denominator - remainder
+        Sint64 numerator = originX * dY + ( (Sint64) y * subpixel_steps - originY ) * dX;
+        currentX  = CeilDiv( numerator, denominator );
+        remainder = (Sint64) currentX * denominator - numerator;
+    }
+
+    inline void DoYStep()
+    {
+        currentY++;
+        currentX += xStep;
+        remainder -= remainderStep;
+        if ( remainder < 0 )
+        {
+            currentX++;
+            remainder += denominator;
+        }
+    }
+
+    static inline Sint64 FloorDiv( Sint64 a, Sint64 b )
+    {
+        // b has to be positive
+        return a >= 0 ? a / b : -( ( -a + b - 1 ) / b );
+    }
+    static inline Sint64 CeilDiv( Sint64 a, Sint64 b )
+    {
+        return -FloorDiv( -a, b );
+    }
+
+    private:
+        Sint64 originX = 0, originY = 0;
+        Sint64 dX = 0, dY = 0;
+        Sint64 denominator = 0;
+        Sint64 remainder = 0; // 0 <= remainder < denominator
+        Sint64 xStep = 0, remainderStep = 0;
+};
+
+#endif // FIXEDEDGE_H
@@ -0,0 +1,100 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+class FrameArena
+{
+    // Bump allocator for data that only lives until the end of a frame.
+    // Every thread that produces such data gets its own, so allocating never
+    // takes a lock. Reset() drops everything at once by going back to the first slab.
+    // Slabs are kept, so memory use settles at what the biggest frame needed.
+    //
+    // Destructors are never called, hence only trivially destructible types can be created.
+    // Not thread safe.
+
+public:
+    static const size_t slab_size = 1 << 20;
+
+    FrameArena() {}
+    FrameArena( const FrameArena& ) = delete;
+    FrameArena& operator=( const FrameArena& ) = delete;
+    FrameArena( FrameArena&& ) = default;
+    FrameArena& operator=( FrameArena&& ) = default;
+
+    void* Allocate( size_t size, size_t alignment )
+    {
+        // alignment has to be a power of two
+        while ( true )
+        {
+            if ( current_slab == slabs.size() ) [[unlikely]]
+            {
+                slabs.push_back( Slab( std::max( slab_size, size + alignment ) ) );
+            }
+
+            Slab& slab = slabs[ current_slab ];
+            uintptr_t base  = reinterpret_cast< uintptr_t >( slab.data.get() );
+            uintptr_t start = ( base + offset + alignment - 1 ) & ~( uintptr_t ) ( alignment - 1 );
+            if ( start + size <= base + slab.size ) [[likely]]
+            {
+                offset = start + size - base;
+                used_bytes += size;
+                return reinterpret_cast< void* >( start );
+            }
+
+            // continue with the next slab. the rest of this one stays unused until Reset()
+            current_slab++;
+            offset = 0;
+        }
+    }
+
+    template< class T >
+    T* Create( size_t count = 1 )
+    {
+        // default constructs count elements of T next to each other
+        static_assert( std::is_trivially_destructible_v< T >, "FrameArena never calls destructors" );
+        T* objs = static_cast< T* >( Allocate( count * sizeof( T ), alignof( T ) ) );
+        for ( size_t i = 0; i < count; i++ )
+            new ( objs + i ) T();
+        return objs;
+    }
+
+    inline void Reset()
+    {
+        current_slab = 0;
+        offset = 0;
+        used_bytes = 0;
+    }
+
+    // bytes handed out since the last Reset() and bytes held in total
+    inline size_t GetUsedBytes() const { return used_bytes; }
+    size_t GetReservedBytes() const
+    {
+        size_t reserved = 0;
+        for ( const Slab& slab : slabs )
+            reserved += slab.size;
+        return reserved;
+    }
+
+private:
+    struct Slab
+    {
+        std::unique_ptr< std::byte[] > data;
+        size_t size;
+
+        Slab( size_t size ) : data( new std::byte[ size ] ), size( size ) {}
+    };
+
+    std::vector< Slab > slabs;
+    size_t current_slab = 0;
+    size_t offset = 0; // within current slab
+    size_t used_bytes = 0;
+};
+
+#endif // FRAMEARENA_H
@@ -17,6 +17,8 @@ Mesh::Mesh( const Triangle& tri )
     m_indices.push_back( 1 );
     m_indices.push_back( 2 );
     m_normals.push_back( tri.normal_vec );
+
+    CalculateBounds();
 }
 
 Mesh::Mesh( std::string pathToOBJ )
@@ -115,6 +117,36 @@ Mesh::Mesh( std::string pathToOBJ )
     m_vertices.shrink_to_fit();
     m_indices.shrink_to_fit();
     m_normals.shrink_to_fit();
+
+    CalculateBounds();
+}
+
+void Mesh::CalculateBounds()
+{
+    // sphere around the centre of the axis aligned bounding box. Not the tightest
+    // possible sphere but good enough for sorting and culling.
+    if ( m_vertices.empty() )
+        return;
+
+    Vector3f low  = Vector3f( m_vertices[0].posVec.x, m_vertices[0].posVec.y, m_vertices[0].posVec.z );
+    Vector3f high = low;
+    for ( const auto& vertex : m_vertices )
+    {
+        low.x  = std::min( low.x,  vertex.posVec.x );
+        low.y  = std::min( low.y,  vertex.posVec.y );
+        low.z  = std::min( low.z,  vertex.posVec.z );
+        high.x = std::max( high.x, vertex.posVec.x );
+        high.y = std::max( high.y, vertex.posVec.y );
+        high.z = std::max( high.z, vertex.posVec.z );
+    }
+    m_boundsCenter = ( low + high ) * 0.5f;
+
+    m_boundsRadius = 0;
+    for ( const auto& vertex : m_vertices )
+    {
+        Vector3f distance = Vector3f( vertex.posVec.x, vertex.posVec.y, vertex.posVec.z ) - m_boundsCenter;
+        m_boundsRadius = std::max( m_boundsRadius, distance.length() );
+    }
 }
 
 Triangle Mesh::GetTriangle( Uint32 index ) const
@@ -23,6 +23,9 @@ class Mesh
         inline Uint32 GetTriangleCount() const { return m_indices.size() / 3; }
         inline Uint32 GetVertexCount() const { return m_vertices.size(); }
         inline Uint32 GetIndicesCount() const { return m_indices.size(); }
+        // bounding sphere in object space
+        inline Vector3f GetBoundsCenter() const { return m_boundsCenter; }
+        inline float GetBoundsRadius() const { return m_boundsRadius; }
 
     protected:
 
@@ -30,8 +33,11 @@ class Mesh
         std::vector< Vertexf > m_vertices;
         std::vector< Uint32 > m_indices;
         std::vector< Vector3f > m_normals;
+        Vector3f m_boundsCenter = Vector3f();
+        float m_boundsRadius = 0;
 
         // internal functions
+        void CalculateBounds();
         int64_t OBJindexToNewIndex( const tinyobj::attrib_t& attrib, const tinyobj::index_t& obj_index, shared_ptr< std::unordered_map<int, Uint32> > OBJtoNew_List );
 
 };
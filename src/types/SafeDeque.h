@@ -18,45 +18,12 @@ public:
 
     SafeDeque() {}
 
-    inline T at ( std::size_t pos ) const
-    {
-        return T( deque.at( pos ) );
-    }
-
     inline const size_t size()
     {
+        std::lock_guard< std::mutex > lock( mutex );
         return deque.size();
     }
 
-    inline bool empty()
-    {
-        return deque.empty();
-    }
-
-    inline bool blocked()
-    {
-        return new_blocked;
-    }
-
-    inline bool isLast( size_t index )
-    {
-        return index >= deque.size();
-    }
-
-    bool isLastBlocked( size_t index )
-    {
-        std::unique_lock< std::mutex > lock( mutex );
-        if ( isLast( index ) ) [[unlikely]]
-        {
-            while ( !blocked() )
-                cond_islast.wait( lock );
-            return isLast( index );
-        } else { [[likely]]
-            return false;
-        }
-    }
-
-
     void clear()
     {
         std::unique_lock< std::mutex > lock( mutex );
@@ -70,7 +37,6 @@ public:
         std::lock_guard< std::mutex > lock( mutex );
         new_blocked = true;
         cond_mod.notify_all();
-        cond_islast.notify_all();
     }
 
     inline void unblock_new()
@@ -89,31 +55,28 @@ public:
         cond_mod.notify_one();
     }
 
-    unique_ptr< T > pop( )
+    bool pop( T& obj )
     {
         // By default in blocking mode (waits for new objects if queue
         // is empty). However returns false if queue is
-        // empty AND new_blocked == true.
-        if ( blocked() ) {
-            return nullptr;
-        }
-
+        // empty AND new_blocked == true. Objects that were added
+        // before blocking are still handed out.
         std::unique_lock< std::mutex > lock( mutex );
 
         // wait until data arrives or queue is blocked
-        while ( !blocked() && empty() )
+        while ( !new_blocked && deque.empty() )
         {
             cond_mod.wait( lock );
         }
 
-        if ( blocked() || empty() ) {
-            return nullptr;
+        if ( deque.empty() ) {
+            return false;
         }
 
-        unique_ptr< T > ret = make_unique<T> ( T( deque.front() ) );
+        obj = std::move( deque.front() );
         deque.pop_front();
 
-        return ret;
+        return true;
     }
 
 private:
@@ -122,7 +85,6 @@ private:
     bool new_blocked = false;
     std::mutex mutex;
     std::condition_variable cond_mod;
-    std::condition_variable cond_islast;
 };
 
 #endif // SAFEDEQUE_H
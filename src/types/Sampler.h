@@ -0,0 +1,438 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "common.h"
+#include "types/Texture.h"
+
+#if defined( __SSE4_1__ ) || defined( __AVX2__ )
+    #include <immintrin.h>
+#endif
+
+struct TextureLevel
+{
+    // texels of a single mip level of a texture
+
+    const Uint32* texels = nullptr;
+    int width = 0, height = 0;
+    int stride = 0; // see Texture::GetPixelIndex
+    int stride_shift = 0; // log2 of stride for power of two textures
+
+    TextureLevel() {}
+    TextureLevel( const Texture& texture, Uint8 level )
+    {
+        texels = texture.GetMipPixels( level );
+        width  = texture.GetMipWidth( level );
+        height = texture.GetMipHeight( level );
+        stride = texture.GetMipStride( level );
+        while ( ( 1 << ( stride_shift + 1 ) ) <= stride )
+            stride_shift++;
+    }
+};
+
+// texture filters a Sampler can apply on its level(s)
+static const Uint8 sampler_filter_nearest   = 0;
+static const Uint8 sampler_filter_bilinear  = 1;
+static const Uint8 sampler_filter_trilinear = 2; // bilinear on two mip levels, blended
+
+static const int sampler_fixed_shift = 8; // samplers address texels in 24.8 fixed point
+
+template< Uint8 filter, Uint8 wrap, bool tiled, bool pow2 >
+class Sampler
+{
+    // Samples textures for the fragment kernels, with one version per kernel width.
+    // Filter, wrap mode (see Texture), layout and whether the texture is a power
+    // of two are template parameters, so every combination compiles to straight code.
+    //
+    // Texcoords are first moved by whole wrap periods to 0 to 1 (repeat) or 0 to 2 (mirror)
+    // and clamped to -1 to 2, which still samples the same texels. Then they are converted
+    // to texels in 24.8 fixed point once, so texcoords may be anything and textures any size.
+    // From there on everything is integer: flooring is a shift, bilinear weights are the
+    // fraction and texels are blended two channels at a time. Callers that step texels
+    // themselves pass them in fixed point to the SampleTexels versions.
+    // Hence all kernel widths give exactly the same pixels.
+    // Power of two textures wrap with masks and address rows with shifts.
+
+    public:
+        // texcoord is moved by the returned amount of whole wrap periods before sampling
+        static inline float GetWrapShift( float texcoord )
+        {
+            if constexpr ( wrap == Texture::wrap_repeat )
+                return std::floor( texcoord );
+            else if constexpr ( wrap == Texture::wrap_mirror )
+                return 2.0f * std::floor( 0.5f * texcoord );
+            else
+                return 0.0f;
+        }
+
+        // level_blend is the weight of next_level from 0 to 256 and only used for trilinear filtering
+        static inline Uint32 Sample( const TextureLevel& level, const TextureLevel& next_level, Uint32 level_blend, float u, float v )
+        {
+            Sint32 next_x = 0, next_y = 0;
+            if constexpr ( filter == sampler_filter_trilinear )
+            {
+                next_x = ToFixed( u, next_level.width );
+                next_y = ToFixed( v, next_level.height );
+            }
+            return SampleTexels( level, next_level, level_blend, ToFixed( u, level.width ), ToFixed( v, level.height ), next_x, next_y );
+        }
+
+        // x and y are texels of level, next_x and next_y texels of next_level
+        static inline Uint32 SampleTexels( const TextureLevel& level, const TextureLevel& next_level, Uint32 level_blend,
+                                           Sint32 x, Sint32 y, Sint32 next_x, Sint32 next_y )
+        {
+            if constexpr ( filter == sampler_filter_trilinear )
+                return LerpTexels( SampleBilinear( level, x, y ), SampleBilinear( next_level, next_x, next_y ), level_blend );
+            else if constexpr ( filter == sampler_filter_bilinear )
+                return SampleBilinear( level, x, y );
+            else
+                return SampleNearest( level, x, y );
+        }
+
+#if defined( __SSE4_1__ )
+        static inline __m128i Sample4( const TextureLevel& level, const TextureLevel& next_level, Uint32 level_blend, __m128 u, __m128 v )
+        {
+            __m128i next_x = _mm_setzero_si128(), next_y = _mm_setzero_si128();
+            if constexpr ( filter == sampler_filter_trilinear )
+            {
+                next_x = ToFixed4( u, next_level.width );
+                next_y = ToFixed4( v, next_level.height );
+            }
+            return SampleTexels4( level, next_level, level_blend, ToFixed4( u, level.width ), ToFixed4( v, level.height ), next_x, next_y );
+        }
+
+        static inline __m128i SampleTexels4( const TextureLevel& level, const TextureLevel& next_level, Uint32 level_blend,
+                                             __m128i x, __m128i y, __m128i next_x, __m128i next_y )
+        {
+            if constexpr ( filter == sampler_filter_trilinear )
+                return LerpTexels4( SampleBilinear4( level, x, y ), SampleBilinear4( next_level, next_x, next_y ), _mm_set1_epi32( level_blend ) );
+            else if constexpr ( filter == sampler_filter_bilinear )
+                return SampleBilinear4( level, x, y );
+            else
+                return SampleNearest4( level, x, y );
+        }
+#endif
+
+#if defined( __AVX2__ )
+        // only lanes set in mask are fetched
+        static inline __m256i Sample8( const TextureLevel& level, const TextureLevel& next_level, Uint32 level_blend, __m256 u, __m256 v, __m256i mask )
+        {
+            __m256i next_x = _mm256_setzero_si256(), next_y = _mm256_setzero_si256();
+            if constexpr ( filter == sampler_filter_trilinear )
+            {
+                next_x = ToFixed8( u, next_level.width );
+                next_y = ToFixed8( v, next_level.height );
+            }
+            return SampleTexels8( level, next_level, level_blend, ToFixed8( u, level.width ), ToFixed8( v, level.height ), next_x, next_y, mask );
+        }
+
+        static inline __m256i SampleTexels8( const TextureLevel& level, const TextureLevel& next_level, Uint32 level_blend,
+                                             __m256i x, __m256i y, __m256i next_x, __m256i next_y, __m256i mask )
+        {
+            if constexpr ( filter == sampler_filter_trilinear )
+                return LerpTexels8( SampleBilinear8( level, x, y, mask ), SampleBilinear8( next_level, next_x, next_y, mask ), _mm256_set1_epi32( level_blend ) );
+            else if constexpr ( filter == sampler_filter_bilinear )
+                return SampleBilinear8( level, x, y, mask );
+            else
+                return SampleNearest8( level, x, y, mask );
+        }
+#endif
+
+    private:
+        //-- scalar
+        static inline Sint32 ToFixed( float texcoord, int size )
+        {
+            // same order of operations as the SIMD versions, including nan
+            texcoord = texcoord - GetWrapShift( texcoord );
+            texcoord = texcoord < 2.0f ? texcoord : 2.0f;
+            texcoord = texcoord > -1.0f ? texcoord : -1.0f;
+            return (Sint32) ( texcoord * (float) ( size << sampler_fixed_shift ) );
+        }
+
+        static inline int Wrap( int x, int size )
+        {
+            if constexpr ( wrap == Texture::wrap_clamp )
+            {
+                return clipNumber( x, 0, size - 1 );
+            }
+            else if constexpr ( wrap == Texture::wrap_repeat )
+            {
+                if constexpr ( pow2 )
+                    return x & ( size - 1 );
+                int r = x % size;
+                return r < 0 ? r + size : r;
+            }
+            else
+            {
+                // repeat with twice the size, the second half is flipped
+                int r;
+                if constexpr ( pow2 )
+                {
+                    r = x & ( 2 * size - 1 );
+                }
+                else
+                {
+                    r = x % ( 2 * size );
+                    r = r < 0 ? r + 2 * size : r;
+                }
+                return r < size ? r : 2 * size - 1 - r;
+            }
+        }
+
+        static inline Uint32 GetOffset( const TextureLevel& level, int x, int y )
+        {
+            if constexpr ( pow2 )
+            {
+                if constexpr ( tiled )
+                    return ( ( y >> 2 ) << level.stride_shift ) + ( ( x >> 2 ) << 4 ) + ( ( y & 3 ) << 2 ) + ( x & 3 );
+                else
+                    return ( y << level.stride_shift ) + x;
+            }
+            return Texture::GetPixelIndex( x, y, level.stride, tiled );
+        }
+
+        static inline Uint32 LerpTexels( Uint32 a, Uint32 b, Uint32 weight )
+        {
+            // blends two channels at once. every channel gets 16 bits so they can't overflow.
+            Uint32 rb = ( ( a & 0x00FF00FF ) * ( 256 - weight ) + ( b & 0x00FF00FF ) * weight + 0x00800080 ) >> 8;
+            Uint32 ag = ( ( a >> 8 ) & 0x00FF00FF ) * ( 256 - weight ) + ( ( b >> 8 ) & 0x00FF00FF ) * weight + 0x00800080;
+            return ( rb & 0x00FF00FF ) | ( ag & 0xFF00FF00 );
+        }
+
+        static inline Uint32 SampleNearest( const TextureLevel& level, Sint32 fixedX, Sint32 fixedY )
+        {
+            int x = Wrap( fixedX >> sampler_fixed_shift, level.width );
+            int y = Wrap( fixedY >> sampler_fixed_shift, level.height );
+            return level.texels[ GetOffset( level, x, y ) ];
+        }
+
+        static inline Uint32 SampleBilinear( const TextureLevel& level, Sint32 fixedX, Sint32 fixedY )
+        {
+            // texel centres are at .5, so move half a texel to find the top left one
+            fixedX -= 1 << ( sampler_fixed_shift - 1 );
+            fixedY -= 1 << ( sampler_fixed_shift - 1 );
+            Uint32 weightX = fixedX & 0xFF;
+            Uint32 weightY = fixedY & 0xFF;
+
+            int x0 = Wrap( fixedX >> sampler_fixed_shift, level.width ),  x1 = Wrap( ( fixedX >> sampler_fixed_shift ) + 1, level.width );
+            int y0 = Wrap( fixedY >> sampler_fixed_shift, level.height ), y1 = Wrap( ( fixedY >> sampler_fixed_shift ) + 1, level.height );
+
+            Uint32 top    = LerpTexels( level.texels[ GetOffset( level, x0, y0 ) ], level.texels[ GetOffset( level, x1, y0 ) ], weightX );
+            Uint32 bottom = LerpTexels( level.texels[ GetOffset( level, x0, y1 ) ], level.texels[ GetOffset( level, x1, y1 ) ], weightX );
+            return LerpTexels( top, bottom, weightY );
+        }
+
+#if defined( __SSE4_1__ )
+        //-- SSE4.1. There is no gather, so texels are fetched one by one.
+        static inline __m128i ToFixed4( __m128 texcoord, int size )
+        {
+            if constexpr ( wrap == Texture::wrap_repeat )
+                texcoord = _mm_sub_ps( texcoord, _mm_floor_ps( texcoord ) );
+            else if constexpr ( wrap == Texture::wrap_mirror )
+                texcoord = _mm_sub_ps( texcoord, _mm_mul_ps( _mm_set1_ps( 2.0f ), _mm_floor_ps( _mm_mul_ps( _mm_set1_ps( 0.5f ), texcoord ) ) ) );
+            texcoord = _mm_max_ps( _mm_min_ps( texcoord, _mm_set1_ps( 2.0f ) ), _mm_set1_ps( -1.0f ) );
+            return _mm_cvttps_epi32( _mm_mul_ps( texcoord, _mm_set1_ps( (float) ( size << sampler_fixed_shift ) ) ) );
+        }
+
+        static inline __m128i Modulo4( __m128i x, int period )
+        {
+            // float division might be off by one, which is corrected afterwards
+            __m128 quotient = _mm_floor_ps( _mm_mul_ps( _mm_cvtepi32_ps( x ), _mm_set1_ps( 1.0f / period ) ) );
+            __m128i r = _mm_sub_epi32( x, _mm_mullo_epi32( _mm_cvttps_epi32( quotient ), _mm_set1_epi32( period ) ) );
+            r = _mm_add_epi32( r, _mm_and_si128( _mm_cmpgt_epi32( _mm_setzero_si128(), r ), _mm_set1_epi32( period ) ) );
+            r = _mm_sub_epi32( r, _mm_and_si128( _mm_cmpgt_epi32( r, _mm_set1_epi32( period - 1 ) ), _mm_set1_epi32( period ) ) );
+            return r;
+        }
+
+        static inline __m128i Wrap4( __m128i x, int size )
+        {
+            if constexpr ( wrap == Texture::wrap_clamp )
+            {
+                return _mm_min_epi32( _mm_max_epi32( x, _mm_setzero_si128() ), _mm_set1_epi32( size - 1 ) );
+            }
+            else if constexpr ( wrap == Texture::wrap_repeat )
+            {
+                if constexpr ( pow2 )
+                    return _mm_and_si128( x, _mm_set1_epi32( size - 1 ) );
+                return Modulo4( x, size );
+            }
+            else
+            {
+                __m128i r;
+                if constexpr ( pow2 )
+                    r = _mm_and_si128( x, _mm_set1_epi32( 2 * size - 1 ) );
+                else
+                    r = Modulo4( x, 2 * size );
+                __m128i flipped = _mm_sub_epi32( _mm_set1_epi32( 2 * size - 1 ), r );
+                return _mm_blendv_epi8( r, flipped, _mm_cmpgt_epi32( r, _mm_set1_epi32( size - 1 ) ) );
+            }
+        }
+
+        static inline __m128i GetOffsets4( const TextureLevel& level, __m128i x, __m128i y )
+        {
+            __m128i row;
+            if constexpr ( tiled )
+            {
+                static_assert( Texture::tile_size == 4, "offsets assume 4x4 tiles" );
+                row = pow2 ? _mm_sll_epi32( _mm_srli_epi32( y, 2 ), _mm_cvtsi32_si128( level.stride_shift ) )
+                           : _mm_mullo_epi32( _mm_srli_epi32( y, 2 ), _mm_set1_epi32( level.stride ) );
+                __m128i in_tile = _mm_add_epi32( _mm_slli_epi32( _mm_and_si128( y, _mm_set1_epi32( 3 ) ), 2 ), _mm_and_si128( x, _mm_set1_epi32( 3 ) ) );
+                return _mm_add_epi32( _mm_add_epi32( row, _mm_slli_epi32( _mm_srli_epi32( x, 2 ), 4 ) ), in_tile );
+            }
+            row = pow2 ? _mm_sll_epi32( y, _mm_cvtsi32_si128( level.stride_shift ) )
+                       : _mm_mullo_epi32( y, _mm_set1_epi32( level.stride ) );
+            return _mm_add_epi32( row, x );
+        }
+
+        static inline __m128i Fetch4( const TextureLevel& level, __m128i x, __m128i y )
+        {
+            alignas( 16 ) Sint32 offsets[4];
+            _mm_store_si128( (__m128i*) offsets, GetOffsets4( level, x, y ) );
+            return _mm_setr_epi32( level.texels[ offsets[0] ], level.texels[ offsets[1] ],
+                                   level.texels[ offsets[2] ], level.texels[ offsets[3] ] );
+        }
+
+        static inline __m128i LerpTexels4( __m128i a, __m128i b, __m128i weight )
+        {
+            // same as LerpTexels. Products stay below 2^16 so 16 bit multiplies are enough.
+            const __m128i mask = _mm_set1_epi32( 0x00FF00FF );
+            const __m128i round = _mm_set1_epi32( 0x00800080 );
+            __m128i weight_b = _mm_or_si128( weight, _mm_slli_epi32( weight, 16 ) );
+            __m128i weight_a = _mm_sub_epi16( _mm_set1_epi16( 256 ), weight_b );
+            __m128i rb = _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( _mm_and_si128( a, mask ), weight_a ),
+                                                       _mm_mullo_epi16( _mm_and_si128( b, mask ), weight_b ) ), round );
+            __m128i ag = _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( _mm_and_si128( _mm_srli_epi32( a, 8 ), mask ), weight_a ),
+                                                       _mm_mullo_epi16( _mm_and_si128( _mm_srli_epi32( b, 8 ), mask ), weight_b ) ), round );
+            return _mm_or_si128( _mm_and_si128( _mm_srli_epi32( rb, 8 ), mask ), _mm_andnot_si128( mask, ag ) );
+        }
+
+        static inline __m128i SampleNearest4( const TextureLevel& level, __m128i fixedX, __m128i fixedY )
+        {
+            __m128i x = Wrap4( _mm_srai_epi32( fixedX, sampler_fixed_shift ), level.width );
+            __m128i y = Wrap4( _mm_srai_epi32( fixedY, sampler_fixed_shift ), level.height );
+            return Fetch4( level, x, y );
+        }
+
+        static inline __m128i SampleBilinear4( const TextureLevel& level, __m128i fixedX, __m128i fixedY )
+        {
+            fixedX = _mm_sub_epi32( fixedX, _mm_set1_epi32( 1 << ( sampler_fixed_shift - 1 ) ) );
+            fixedY = _mm_sub_epi32( fixedY, _mm_set1_epi32( 1 << ( sampler_fixed_shift - 1 ) ) );
+            __m128i weightX = _mm_and_si128( fixedX, _mm_set1_epi32( 0xFF ) );
+            __m128i weightY = _mm_and_si128( fixedY, _mm_set1_epi32( 0xFF ) );
+
+            __m128i x = _mm_srai_epi32( fixedX, sampler_fixed_shift ), y = _mm_srai_epi32( fixedY, sampler_fixed_shift );
+            __m128i x0 = Wrap4( x, level.width ),  x1 = Wrap4( _mm_add_epi32( x, _mm_set1_epi32( 1 ) ), level.width );
+            __m128i y0 = Wrap4( y, level.height ), y1 = Wrap4( _mm_add_epi32( y, _mm_set1_epi32( 1 ) ), level.height );
+
+            __m128i top    = LerpTexels4( Fetch4( level, x0, y0 ), Fetch4( level, x1, y0 ), weightX );
+            __m128i bottom = LerpTexels4( Fetch4( level, x0, y1 ), Fetch4( level, x1, y1 ), weightX );
+            return LerpTexels4( top, bottom, weightY );
+        }
+#endif
+
+#if defined( __AVX2__ )
+        //-- AVX2
+        static inline __m256i ToFixed8( __m256 texcoord, int size )
+        {
+            if constexpr ( wrap == Texture::wrap_repeat )
+                texcoord = _mm256_sub_ps( texcoord, _mm256_floor_ps( texcoord ) );
+            else if constexpr ( wrap == Texture::wrap_mirror )
+                texcoord = _mm256_sub_ps( texcoord, _mm256_mul_ps( _mm256_set1_ps( 2.0f ), _mm256_floor_ps( _mm256_mul_ps( _mm256_set1_ps( 0.5f ), texcoord ) ) ) );
+            texcoord = _mm256_max_ps( _mm256_min_ps( texcoord, _mm256_set1_ps( 2.0f ) ), _mm256_set1_ps( -1.0f ) );
+            return _mm256_cvttps_epi32( _mm256_mul_ps( texcoord, _mm256_set1_ps( (float) ( size << sampler_fixed_shift ) ) ) );
+        }
+
+        static inline __m256i Modulo8( __m256i x, int period )
+        {
+            // float division might be off by one, which is corrected afterwards
+            __m256 quotient = _mm256_floor_ps( _mm256_mul_ps( _mm256_cvtepi32_ps( x ), _mm256_set1_ps( 1.0f / period ) ) );
+            __m256i r = _mm256_sub_epi32( x, _mm256_mullo_epi32( _mm256_cvttps_epi32( quotient ), _mm256_set1_epi32( period ) ) );
+            r = _mm256_add_epi32( r, _mm256_and_si256( _mm256_cmpgt_epi32( _mm256_setzero_si256(), r ), _mm256_set1_epi32( period ) ) );
+            r = _mm256_sub_epi32( r, _mm256_and_si256( _mm256_cmpgt_epi32( r, _mm256_set1_epi32( period - 1 ) ), _mm256_set1_epi32( period ) ) );
+            return r;
+        }
+
+        static inline __m256i Wrap8( __m256i x, int size )
+        {
+            if constexpr ( wrap == Texture::wrap_clamp )
+            {
+                return _mm256_min_epi32( _mm256_max_epi32( x, _mm256_setzero_si256() ), _mm256_set1_epi32( size - 1 ) );
+            }
+            else if constexpr ( wrap == Texture::wrap_repeat )
+            {
+                if constexpr ( pow2 )
+                    return _mm256_and_si256( x, _mm256_set1_epi32( size - 1 ) );
+                return Modulo8( x, size );
+            }
+            else
+            {
+                __m256i r;
+                if constexpr ( pow2 )
+                    r = _mm256_and_si256( x, _mm256_set1_epi32( 2 * size - 1 ) );
+                else
+                    r = Modulo8( x, 2 * size );
+                __m256i flipped = _mm256_sub_epi32( _mm256_set1_epi32( 2 * size - 1 ), r );
+                return _mm256_blendv_epi8( r, flipped, _mm256_cmpgt_epi32( r, _mm256_set1_epi32( size - 1 ) ) );
+            }
+        }
+
+        static inline __m256i GetOffsets8( const TextureLevel& level, __m256i x, __m256i y )
+        {
+            __m256i row;
+            if constexpr ( tiled )
+            {
+                static_assert( Texture::tile_size == 4, "offsets assume 4x4 tiles" );
+                row = pow2 ? _mm256_sll_epi32( _mm256_srli_epi32( y, 2 ), _mm_cvtsi32_si128( level.stride_shift ) )
+                           : _mm256_mullo_epi32( _mm256_srli_epi32( y, 2 ), _mm256_set1_epi32( level.stride ) );
+                __m256i in_tile = _mm256_add_epi32( _mm256_slli_epi32( _mm256_and_si256( y, _mm256_set1_epi32( 3 ) ), 2 ), _mm256_and_si256( x, _mm256_set1_epi32( 3 ) ) );
+                return _mm256_add_epi32( _mm256_add_epi32( row, _mm256_slli_epi32( _mm256_srli_epi32( x, 2 ), 4 ) ), in_tile );
+            }
+            row = pow2 ? _mm256_sll_epi32( y, _mm_cvtsi32_si128( level.stride_shift ) )
+                       : _mm256_mullo_epi32( y, _mm256_set1_epi32( level.stride ) );
+            return _mm256_add_epi32( row, x );
+        }
+
+        static inline __m256i Fetch8( const TextureLevel& level, __m256i x, __m256i y, __m256i mask )
+        {
+            return _mm256_mask_i32gather_epi32( _mm256_setzero_si256(), (const int*) level.texels, GetOffsets8( level, x, y ), mask, 4 );
+        }
+
+        static inline __m256i LerpTexels8( __m256i a, __m256i b, __m256i weight )
+        {
+            // same as LerpTexels. Products stay below 2^16 so 16 bit multiplies are enough.
+            const __m256i mask = _mm256_set1_epi32( 0x00FF00FF );
+            const __m256i round = _mm256_set1_epi32( 0x00800080 );
+            __m256i weight_b = _mm256_or_si256( weight, _mm256_slli_epi32( weight, 16 ) );
+            __m256i weight_a = _mm256_sub_epi16( _mm256_set1_epi16( 256 ), weight_b );
+            __m256i rb = _mm256_add_epi16( _mm256_add_epi16( _mm256_mullo_epi16( _mm256_and_si256( a, mask ), weight_a ),
+                                                             _mm256_mullo_epi16( _mm256_and_si256( b, mask ), weight_b ) ), round );
+            __m256i ag = _mm256_add_epi16( _mm256_add_epi16( _mm256_mullo_epi16( _mm256_and_si256( _mm256_srli_epi32( a, 8 ), mask ), weight_a ),
+                                                             _mm256_mullo_epi16( _mm256_and_si256( _mm256_srli_epi32( b, 8 ), mask ), weight_b ) ), round );
+            return _mm256_or_si256( _mm256_and_si256( _mm256_srli_epi32( rb, 8 ), mask ), _mm256_andnot_si256( mask, ag ) );
+        }
+
+        static inline __m256i SampleNearest8( const TextureLevel& level, __m256i fixedX, __m256i fixedY, __m256i mask )
+        {
+            __m256i x = Wrap8( _mm256_srai_epi32( fixedX, sampler_fixed_shift ), level.width );
+            __m256i y = Wrap8( _mm256_srai_epi32( fixedY, sampler_fixed_shift ), level.height );
+            return Fetch8( level, x, y, mask );
+        }
+
+        static inline __m256i SampleBilinear8( const TextureLevel& level, __m256i fixedX, __m256i fixedY, __m256i mask )
+        {
+            fixedX = _mm256_sub_epi32( fixedX, _mm256_set1_epi32( 1 << ( sampler_fixed_shift - 1 ) ) );
+            fixedY = _mm256_sub_epi32( fixedY, _mm256_set1_epi32( 1 << ( sampler_fixed_shift - 1 ) ) );
+            __m256i weightX = _mm256_and_si256( fixedX, _mm256_set1_epi32( 0xFF ) );
+            __m256i weightY = _mm256_and_si256( fixedY, _mm256_set1_epi32( 0xFF ) );
+
+            __m256i x = _mm256_srai_epi32( fixedX, sampler_fixed_shift ), y = _mm256_srai_epi32( fixedY, sampler_fixed_shift );
+            __m256i x0 = Wrap8( x, level.width ),  x1 = Wrap8( _mm256_add_epi32( x, _mm256_set1_epi32( 1 ) ), level.width );
+            __m256i y0 = Wrap8( y, level.height ), y1 = Wrap8( _mm256_add_epi32( y, _mm256_set1_epi32( 1 ) ), level.height );
+
+            __m256i top    = LerpTexels8( Fetch8( level, x0, y0, mask ), Fetch8( level, x1, y0, mask ), weightX );
+            __m256i bottom = LerpTexels8( Fetch8( level, x0, y1, mask ), Fetch8( level, x1, y1, mask ), weightX );
+            return LerpTexels8( top, bottom, weightY );
+        }
+#endif
+};
+
+#endif // SAMPLER_H
@@ -0,0 +1,29 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include "common.h"
+#include "Vertex.h"
+
+template< typename T >
+struct Span
+{
+    // A run of pixels on a single scanline that are covered by a triangle.
+    // Both rasteriser backends produce spans and hand them to the same
+    // fragment loop.
+    // Attributes (see Vertex.h) hold their value at x_begin. Their steps are per pixel.
+
+    int x_begin = 0;
+    int x_end   = 0; // exclusive
+    Uint16 y    = 0; // absolute screen y
+
+    T values[attribute_count] = {};
+    T steps[attribute_count]  = {};
+
+    // value of attribute i pixels right of x_begin
+    inline T Get( Uint8 attribute, T i ) const { return values[attribute] + steps[attribute] * i; }
+};
+
+typedef Span< float > Spanf;
+typedef Span< double > Spand;
+
+#endif // SPAN_H
@@ -19,29 +19,26 @@ TexCoordsForEdge<T>::TexCoordsForEdge(const Vertex<T>& vertMin, const Vertex<T>&
     T oneOverdX = 1.0f / dX;
     T oneOverdY = -oneOverdX;
 
-    // calculate texCoord values from verts
-    depth_values[0] = vertMin.posVec.z;
-    depth_values[1] = vertMid.posVec.z;
-    depth_values[2] = vertMax.posVec.z;
-    oneOverZ_values[0] = 1.0f / vertMin.posVec.w;
-    oneOverZ_values[1] = 1.0f / vertMid.posVec.w;
-    oneOverZ_values[2] = 1.0f / vertMax.posVec.w;
-    texCoordX_values[0] = vertMin.texVec.x * oneOverZ_values[0];
-    texCoordX_values[1] = vertMid.texVec.x * oneOverZ_values[1];
-    texCoordX_values[2] = vertMax.texVec.x * oneOverZ_values[2];
-    texCoordY_values[0] = vertMin.texVec.y * oneOverZ_values[0];
-    texCoordY_values[1] = vertMid.texVec.y * oneOverZ_values[1];
-    texCoordY_values[2] = vertMax.texVec.y * oneOverZ_values[2];
+    // calculate attribute values from verts. everything but depth and oneOverZ
+    // gets multiplied by oneOverZ for perspective correction.
+    const Vertex<T>* verts[3] = { &vertMin, &vertMid, &vertMax };
+    for ( int i = 0; i < 3; i++ )
+    {
+        T oneOverZ = 1.0f / verts[i]->posVec.w;
+        values[attribute_depth][i]     = verts[i]->posVec.z;
+        values[attribute_oneOverZ][i]  = oneOverZ;
+        values[attribute_texCoordX][i] = verts[i]->texVec.x * oneOverZ;
+        values[attribute_texCoordY][i] = verts[i]->texVec.y * oneOverZ;
+        for ( Uint8 varying = 0; varying < vertex_varying_count; varying++ )
+            values[attribute_varyings + varying][i] = verts[i]->varyings[varying] * oneOverZ;
+    }
 
-    // calculate texCoord steps
-    texCoordX_XStep = calcXStep( texCoordX_values, oneOverdX, vertMin, vertMid, vertMax );
-    texCoordX_YStep = calcYStep( texCoordX_values, oneOverdY, vertMin, vertMid, vertMax );
-    texCoordY_XStep = calcXStep( texCoordY_values, oneOverdX, vertMin, vertMid, vertMax );
-    texCoordY_YStep = calcYStep( texCoordY_values, oneOverdY, vertMin, vertMid, vertMax );
-    oneOverZ_XStep  = calcXStep( oneOverZ_values,  oneOverdX, vertMin, vertMid, vertMax );
-    oneOverZ_YStep  = calcYStep( oneOverZ_values,  oneOverdY, vertMin, vertMid, vertMax );
-    depth_XStep     = calcXStep( depth_values, oneOverdX, vertMin, vertMid, vertMax );
-    depth_YStep     = calcYStep( depth_values, oneOverdY, vertMin, vertMid, vertMax );
+    // calculate steps of all attributes
+    for ( Uint8 attribute = 0; attribute < attribute_count; attribute++ )
+    {
+        x_steps[attribute] = calcXStep( values[attribute], oneOverdX, vertMin, vertMid, vertMax );
+        y_steps[attribute] = calcYStep( values[attribute], oneOverdY, vertMin, vertMid, vertMax );
+    }
 }
 
 template< typename T >
@@ -62,13 +59,6 @@ T TexCoordsForEdge<T>::calcYStep(const T(& values)[3], const T& oneOver_dY, cons
              (vertMid.posVec.x - vertMax.posVec.x) ) ) * oneOver_dY;
 }
 
-template< typename T >
-TexCoordsForEdge<T>::~TexCoordsForEdge()
-{
-    //dtor
-
-}
-
 // now make sure that the compiler includes implementations for float, double and int
 template struct TexCoordsForEdge< float >;
 template struct TexCoordsForEdge< double >;
@@ -9,42 +9,27 @@ struct TexCoordsForEdge
     // Used by rasteriser to calculate texcoord steps.
     // Due to its knowledge about all the other edges it can do these caculations
     // in its ctor.
+    //
+    // Holds the plane equation of every attribute (see Vertex.h): its values at
+    // the three vertices and its change per pixel in x and y.
 
     public:
         TexCoordsForEdge() {} // empty constructor
         TexCoordsForEdge( const Vertex<T>& vertMin, const Vertex<T>& vertMid, const Vertex<T>& vertMax );
-        virtual ~TexCoordsForEdge();
+        ~TexCoordsForEdge() = default;
 
         // getters
-        inline T GetTexCoordX_XStep() const { return texCoordX_XStep; }
-        inline T GetTexCoordX_YStep() const { return texCoordX_YStep; }
-        inline T GetTexCoordY_XStep() const { return texCoordY_XStep; }
-        inline T GetTexCoordY_YStep() const { return texCoordY_YStep; }
-        inline T GetOneOverZ_XStep() const { return oneOverZ_XStep; }
-        inline T GetOneOverZ_YStep() const { return oneOverZ_YStep; }
-        inline T GetDepth_XStep() const { return depth_XStep; }
-        inline T GetDepth_YStep() const { return depth_YStep; }
-        inline T GetTexCoordX( int index ) const { return texCoordX_values[index]; }
-        inline T GetTexCoordY( int index ) const { return texCoordY_values[index]; }
-        inline T GetOneOverZ( int index ) const { return oneOverZ_values[index]; }
-        inline T GetDepth( int index ) const { return depth_values[index]; }
+        inline T GetXStep( Uint8 attribute ) const { return x_steps[attribute]; }
+        inline T GetYStep( Uint8 attribute ) const { return y_steps[attribute]; }
+        inline T GetValue( Uint8 attribute, int index ) const { return values[attribute][index]; }
 
     private:
         //-- vars
-        // texcoord steps
-        T texCoordX_XStep;
-        T texCoordX_YStep;
-        T texCoordY_XStep;
-        T texCoordY_YStep;
-        T oneOverZ_XStep;
-        T oneOverZ_YStep;
-        T depth_XStep;
-        T depth_YStep;
-        // texcoord arrays (each element represents the 3 vertexes with 0=min, 1=mid, 2=max)
-        T texCoordX_values[3];
-        T texCoordY_values[3];
-        T oneOverZ_values[3];
-        T depth_values[3];
+        // steps per attribute
+        T x_steps[attribute_count];
+        T y_steps[attribute_count];
+        // values per attribute (each element represents the 3 vertexes with 0=min, 1=mid, 2=max)
+        T values[attribute_count][3];
 
         //-- step calc functions
         // these functions calculate the xstep / ystep for given vertexes and values passed by reference
@@ -30,6 +30,10 @@ Texture::Texture( const char* pathtofile )
     {
         ImportFromSurface( textureSurface );
         SDL_FreeSurface( textureSurface );
+        if ( tiledTextures )
+            ConvertToTiled();
+        else
+            BuildMipmaps();
     }
     else
     {
@@ -91,7 +95,7 @@ const SDL_Color Texture::GetPixel( const Uint16& x, const Uint16& y ) const
     {
         throw ( std::runtime_error("Invalid coordinates for texture access!") );
     }
-    return getSDLColorFor_Pixel(t_pixels.at( y * t_width + x ));
+    return getSDLColorFor_Pixel(t_pixels.at( GetPixelIndex( x, y, GetStride( t_width ), t_tiled ) ));
 }
 
 const Uint32 Texture::GetPixelRaw( const Uint16& x, const Uint16& y ) const
@@ -100,7 +104,7 @@ const Uint32 Texture::GetPixelRaw( const Uint16& x, const Uint16& y ) const
     {
         throw ( std::runtime_error("Invalid coordinates for texture access!") );
     }
-    return t_pixels.at( y * t_width + x );
+    return t_pixels.at( GetPixelIndex( x, y, GetStride( t_width ), t_tiled ) );
 }
 
 void Texture::SetPixel( const Uint16& x, const Uint16& y, const SDL_Color& colour )
@@ -112,10 +116,89 @@ void Texture::SetPixel( const Uint16& x, const Uint16& y, const SDL_Color& colou
     if ( x >= 0 && x < GetWidth() &&
          y >= 0 && y < GetHeight() )
     {
-        t_pixels.at( y * t_width + x ) = getPixelFor_SDLColor(&colour);
+        t_pixels.at( GetPixelIndex( x, y, GetStride( t_width ), t_tiled ) ) = getPixelFor_SDLColor(&colour);
     }
 }
 
+void Texture::BuildMipmaps()
+{
+    // each texel of a level is the average of 2x2 texels of the level above.
+    // Odd sizes are rounded down, the last row and column then reuse their neighbour.
+    t_mipmaps.clear();
+    Uint16 src_width = t_width, src_height = t_height;
+    const Uint32* src = t_pixels.data();
+
+    while ( src_width > 1 || src_height > 1 )
+    {
+        MipLevel level;
+        level.width  = std::max( src_width / 2, 1 );
+        level.height = std::max( src_height / 2, 1 );
+        level.pixels.resize( GetPixelCount( level.width, level.height ) );
+
+        Uint32 src_stride = GetStride( src_width );
+        Uint32 stride = GetStride( level.width );
+        for ( Uint16 y = 0; y < level.height; y++ )
+        {
+            Uint16 y0 = std::min( 2 * y,     src_height - 1 );
+            Uint16 y1 = std::min( 2 * y + 1, src_height - 1 );
+            for ( Uint16 x = 0; x < level.width; x++ )
+            {
+                Uint16 x0 = std::min( 2 * x,     src_width - 1 );
+                Uint16 x1 = std::min( 2 * x + 1, src_width - 1 );
+                const Uint32 texels[4] = { src[ GetPixelIndex( x0, y0, src_stride, t_tiled ) ], src[ GetPixelIndex( x1, y0, src_stride, t_tiled ) ],
+                                           src[ GetPixelIndex( x0, y1, src_stride, t_tiled ) ], src[ GetPixelIndex( x1, y1, src_stride, t_tiled ) ] };
+
+                // average each 8 bit channel with rounding
+                Uint32 pixel = 0;
+                for ( int shift = 0; shift < 32; shift += 8 )
+                {
+                    Uint32 sum = ( ( texels[0] >> shift ) & 0xFF ) + ( ( texels[1] >> shift ) & 0xFF ) +
+                                 ( ( texels[2] >> shift ) & 0xFF ) + ( ( texels[3] >> shift ) & 0xFF );
+                    pixel |= ( ( sum + 2 ) / 4 ) << shift;
+                }
+                level.pixels[ GetPixelIndex( x, y, stride, t_tiled ) ] = pixel;
+            }
+        }
+
+        t_mipmaps.push_back( std::move( level ) );
+        src = t_mipmaps.back().pixels.data();
+        src_width  = t_mipmaps.back().width;
+        src_height = t_mipmaps.back().height;
+    }
+}
+
+void Texture::ConvertToTiled()
+{
+    // reorders pixels into tiles and rebuilds mip levels in the same layout
+    if ( t_tiled )
+        return;
+
+    std::vector< Uint32 > rows = std::move( t_pixels );
+    t_tiled = true;
+    t_pixels.assign( GetPixelCount( t_width, t_height ), 0 );
+    Uint32 stride = GetStride( t_width );
+    for ( Uint16 y = 0; y < t_height; y++ )
+    {
+        for ( Uint16 x = 0; x < t_width; x++ )
+        {
+            t_pixels[ GetPixelIndex( x, y, stride, true ) ] = rows[ y * t_width + x ];
+        }
+    }
+
+    BuildMipmaps();
+}
+
+void Texture::Resize( Uint16 width, Uint16 height )
+{
+    // pixels are not preserved. memory is only reallocated if the texture grows
+    // beyond the biggest size it ever had.
+    t_width = width;
+    t_height = height;
+    t_tiled = false;
+    t_pixels.resize( width * height );
+    t_mipmaps.clear();
+}
+
 void Texture::FillWithRandomColour()
 {
     t_transparent = false;
@@ -19,7 +19,45 @@ class Texture
         const Uint32 GetPixelRaw( const Uint16& x, const Uint16& y ) const;
         void SetPixel( const Uint16& x, const Uint16& y, const SDL_Color& colour );
 
+        // mip chain. level 0 is t_pixels, every further level halves width and height
+        // down to 1x1. Levels are built when a texture is loaded, call BuildMipmaps
+        // again after modifying its pixels.
+        inline Uint8 GetMipLevelCount() const { return 1 + t_mipmaps.size(); }
+        inline const Uint32* GetMipPixels( Uint8 level ) const { return level == 0 ? t_pixels.data() : t_mipmaps[ level - 1 ].pixels.data(); }
+        inline Uint16 GetMipWidth( Uint8 level ) const { return level == 0 ? t_width : t_mipmaps[ level - 1 ].width; }
+        inline Uint16 GetMipHeight( Uint8 level ) const { return level == 0 ? t_height : t_mipmaps[ level - 1 ].height; }
+        inline Uint32 GetMipStride( Uint8 level ) const { return GetStride( GetMipWidth( level ) ); }
+        void BuildMipmaps();
+
+        // Pixels are stored either row by row or, if tiled, in tile_size x tile_size tiles
+        // that follow each other row by row. Texels that are close in any direction then
+        // mostly share a cache line. Stride is the number of pixels from one row (of pixels
+        // or of tiles) to the next. Textures loaded with tiledTextures set are tiled.
+        static const Uint8 tile_size = 4;
+
+        // how texcoords outside of 0 to 1 are sampled
+        static const Uint8 wrap_clamp  = 0; // edge texels are repeated
+        static const Uint8 wrap_repeat = 1;
+        static const Uint8 wrap_mirror = 2; // repeated, every other copy flipped
+        inline Uint8 GetWrapMode() const { return t_wrap_mode; }
+        inline void SetWrapMode( Uint8 wrap_mode )
+        {
+            // samplers only exist for the modes above
+            assert( wrap_mode <= wrap_mirror );
+            t_wrap_mode = wrap_mode <= wrap_mirror ? wrap_mode : wrap_mirror;
+        }
+        inline bool IsPowerOfTwo() const { return ( t_width & ( t_width - 1 ) ) == 0 && ( t_height & ( t_height - 1 ) ) == 0; }
+        inline bool IsTiled() const { return t_tiled; }
+        void ConvertToTiled();
+        static inline Uint32 GetPixelIndex( Uint16 x, Uint16 y, Uint32 stride, bool tiled )
+        {
+            if ( !tiled )
+                return y * stride + x;
+            return ( y / tile_size ) * stride + ( x / tile_size ) * tile_size * tile_size + ( y % tile_size ) * tile_size + x % tile_size;
+        }
+
         // texture modifiers
+        void Resize( Uint16 width, Uint16 height );
         void FillWithRandomColour();
         void FillWithColour( const SDL_Color& colour );
         void clear();
@@ -29,6 +67,19 @@ class Texture
     protected:
         Uint16 t_width = 0, t_height = 0;
         bool t_transparent = false;
+        bool t_tiled = false;
+        Uint8 t_wrap_mode = wrap_clamp;
+
+        struct MipLevel
+        {
+            Uint16 width = 0, height = 0;
+            std::vector< Uint32 > pixels;
+        };
+        std::vector< MipLevel > t_mipmaps;
+
+        // size of a row and of all pixels for the current layout
+        inline Uint32 GetStride( Uint16 width ) const { return t_tiled ? ( width + tile_size - 1 ) / tile_size * tile_size * tile_size : width; }
+        inline Uint32 GetPixelCount( Uint16 width, Uint16 height ) const { return t_tiled ? GetStride( width ) * ( ( height + tile_size - 1 ) / tile_size ) : width * height; }
 
         // imports pixels from an sdl_surface
         void ImportFromSurface( SDL_Surface* surface );
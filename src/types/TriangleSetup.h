@@ -0,0 +1,38 @@
+#ifndef TRIANGLESETUP_H
+#define TRIANGLESETUP_H
+
+#include "Vertex.h"
+#include "Edge.h"
+#include "TexCoordsForEdge.h"
+
+template< typename T >
+struct TriangleSetup
+{
+    // Per triangle setup that only depends on the screen space vertices.
+    // Vertex processors fill it in once per triangle, so that rasterisers
+    // sharing a triangle only step it instead of repeating the setup.
+    //
+    // texcoords holds the plane equations of all interpolants. Scanline
+    // edges hold their slopes and start values and are copied before
+    // they are stepped. The block rasteriser doesn't use them.
+    // Vertices are expected to be sorted by their posVec.y component.
+
+    TexCoordsForEdge<T> texcoords;
+    Edge<T> topToBottom, topToMiddle, middleToBottom;
+
+    TriangleSetup() {}
+    TriangleSetup( const Vertex<T>& vertMin, const Vertex<T>& vertMid, const Vertex<T>& vertMax, bool with_edges )
+    {
+        texcoords = TexCoordsForEdge<T>( vertMin, vertMid, vertMax );
+        if ( with_edges )
+        {
+            topToBottom    = Edge<T>( vertMin, vertMax, texcoords, 0 );
+            topToMiddle    = Edge<T>( vertMin, vertMid, texcoords, 0 );
+            middleToBottom = Edge<T>( vertMid, vertMax, texcoords, 1 );
+        }
+    }
+};
+
+typedef TriangleSetup< float > TriangleSetupf;
+
+#endif // TRIANGLESETUP_H
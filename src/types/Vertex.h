@@ -2,6 +2,22 @@
 #define VERTEX_H
 
 #include "common.h"
+#include <array>
+
+// Number of custom values (colours, normals, extra uv sets, ...) each vertex carries
+// besides position and texcoords.
+static const Uint8 vertex_varying_count = 0;
+
+// Attributes that rasterisers interpolate across triangles. All of them are interpolated
+// by the same plane equation code, one array element per attribute. Depth and oneOverZ
+// are linear in screen space. All others are multiplied by oneOverZ at the vertices and
+// have to be multiplied by z again after interpolation to be perspective correct.
+static const Uint8 attribute_depth     = 0;
+static const Uint8 attribute_oneOverZ  = 1;
+static const Uint8 attribute_texCoordX = 2;
+static const Uint8 attribute_texCoordY = 3;
+static const Uint8 attribute_varyings  = 4; // first of the vertex varyings
+static const Uint8 attribute_count     = attribute_varyings + vertex_varying_count;
 
 // a vertex represents point in a 3 dimensional coordinate system.
 // position is stored in a Vector4 as well as the texel coords of the vertex
@@ -10,6 +26,7 @@ struct Vertex
 {
     Vector4<T> posVec = Vector4<T>();
     Vector2<T> texVec = Vector2<T>();
+    std::array< T, vertex_varying_count > varyings = {};
 
     Vertex()
     {
@@ -21,6 +38,7 @@ struct Vertex
     {
         posVec =  Vector4<T>(v.posVec);
         texVec = Vector2<T>(v.texVec);
+        varyings = v.varyings;
     }
 
     Vertex( const Vector4<T>& posVec, const Vector2<T>& texVec )
@@ -33,6 +51,8 @@ struct Vertex
     {
         posVec = posVec.lerp( lerpamount, other.posVec );
         texVec = texVec.lerp( lerpamount, other.texVec );
+        for ( Uint8 i = 0; i < vertex_varying_count; i++ )
+            varyings[i] += ( other.varyings[i] - varyings[i] ) * lerpamount;
 
         return *this;
     }
@@ -5,6 +5,9 @@
 #include "types/Triangle.h"
 #include "types/Texture.h"
 #include "types/Mesh.h"
+#include "types/SafeDeque.h"
+#include "types/AppendLog.h"
+#include "types/TriangleSetup.h"
 #include "SDL2/SDL_types.h"
 
 struct VertexProcessorInputObject
@@ -18,6 +21,7 @@ struct VertexProcessorInputObject
     Matrix4f objMatrix = Matrix4f();
     SDL_Color colour = SDL_Color();
     shared_ptr< Texture > texture = nullptr;
+    bool sortTriangles = false; // process triangles roughly front to back
 
     // ctors
     VertexProcessorInputObject()
@@ -31,6 +35,7 @@ struct VertexProcessorInputObject
         objMatrix = vpio.objMatrix;
         colour = vpio.colour;
         texture = vpio.texture;
+        sortTriangles = vpio.sortTriangles;
     }
     VertexProcessorInputObject( const Triangle& triangle, const Matrix4f& objMatrix, const SDL_Color& colour )
     {
@@ -71,9 +76,13 @@ struct VertexProcessorOutputObject
 
     Vertexf tris_verts[3] = { Vertexf(), Vertexf(), Vertexf() };
     bool isRightHanded = false;
+    bool isSmall = false; // covers only a few pixels. rasterisers take a shortcut that needs no scanline edges.
+    TriangleSetupf setup; // see CalculateSetup
 
     SDL_Color colour = SDL_Color();
-    shared_ptr< Texture > texture = nullptr;
+    // borrowed from the VPIO. The renderer keeps textures alive until the frame is finished,
+    // so that triangles can be copied around without touching reference counts.
+    const Texture* texture = nullptr;
 
     // ctors
     VertexProcessorOutputObject()
@@ -87,52 +96,62 @@ struct VertexProcessorOutputObject
         tris_verts[0] = vertMin;
         tris_verts[1] = vertMid;
         tris_verts[2] = vertMax;
-        sortVertsByY();
         this->isRightHanded = isRightHanded;
+        sortVertsByY();
 
         this->colour = colour;
     }
     VertexProcessorOutputObject( const Vertexf& vertMin, const Vertexf& vertMid,
-                                 const Vertexf& vertMax, bool isRightHanded, const shared_ptr< Texture >& texture )
+                                 const Vertexf& vertMax, bool isRightHanded, const Texture* texture )
     {
         tris_verts[0] = vertMin;
         tris_verts[1] = vertMid;
         tris_verts[2] = vertMax;
-        sortVertsByY();
         this->isRightHanded = isRightHanded;
+        sortVertsByY();
 
         this->texture = texture;
     }
 
     VertexProcessorOutputObject( const Vertexf& vertMin, const Vertexf& vertMid,
                                  const Vertexf& vertMax, bool isRightHanded,
-                                 const shared_ptr< Texture >& texture, const SDL_Color& colour )
+                                 const Texture* texture, const SDL_Color& colour )
     {
         tris_verts[0] = vertMin;
         tris_verts[1] = vertMid;
         tris_verts[2] = vertMax;
-        sortVertsByY();
         this->isRightHanded = isRightHanded;
+        sortVertsByY();
 
         this->texture = texture;
         this->colour = colour;
     }
 
+    // computes setup from the final vertices. Has to be called before the triangle
+    // is handed to rasterisers. Scanline edges are left out if with_edges is false.
+    void CalculateSetup( bool with_edges )
+    {
+        setup = TriangleSetupf( tris_verts[0], tris_verts[1], tris_verts[2], with_edges );
+    }
 
     void sortVertsByY()
     {
         // sorts verts by posVec.y
+        // every swap reverses the winding order so handedness has to flip with it
         if ( tris_verts[2].posVec.y < tris_verts[1].posVec.y )
         {
             std::swap( tris_verts[1], tris_verts[2] );
+            isRightHanded = !isRightHanded;
         }
         if ( tris_verts[1].posVec.y < tris_verts[0].posVec.y )
         {
             std::swap( tris_verts[0], tris_verts[1] );
+            isRightHanded = !isRightHanded;
         }
         if ( tris_verts[2].posVec.y < tris_verts[1].posVec.y )
         {
             std::swap( tris_verts[1], tris_verts[2] );
+            isRightHanded = !isRightHanded;
         }
     }
 };
@@ -140,4 +159,28 @@ struct VertexProcessorOutputObject
 typedef VertexProcessorInputObject VPIO;
 typedef VertexProcessorOutputObject VPOO;
 
+struct VertexProcessorOutputBin
+{
+    // Queue of triangles for the rasteriser that draws the area from x_begin, y_begin
+    // to x_end, y_end (exclusive). Vertex processors only add triangles whose bounding box
+    // covers at least one pixel of this area.
+
+    Uint16 x_begin = 0, x_end = 0;
+    Uint16 y_begin = 0, y_end = 0;
+    shared_ptr< AppendLog< VPOO > > vpoos = nullptr;
+
+    // ctors
+    VertexProcessorOutputBin() {}
+    VertexProcessorOutputBin( Uint16 x_begin, Uint16 x_end, Uint16 y_begin, Uint16 y_end, const shared_ptr< AppendLog< VPOO > >& vpoos )
+    {
+        this->x_begin = x_begin;
+        this->x_end = x_end;
+        this->y_begin = y_begin;
+        this->y_end = y_end;
+        this->vpoos = vpoos;
+    }
+};
+
+typedef VertexProcessorOutputBin VPOOBin;
+
 #endif // VERTEXPROCESSOROBJ_H
@@ -72,16 +72,9 @@ Window::Window( int width, int height, double scale, std::string title, double f
     SDL_SetTextureBlendMode( r_ltexture, SDL_BLENDMODE_BLEND );
 
 
-    // allocate memory for null_pixels pointer (needs to be freed in dstor!)
-    null_pixels.reset(new Uint32[r_height * r_width]);
-    // fill with color black
+    // pixel ptexture is cleared to colour black
     SDL_Color colour_black = { 0, 0, 0, SDL_ALPHA_TRANSPARENT };
-    Uint32 rgbamap = getPixelFor_SDLColor( &colour_black );
-
-    for ( Uint32 i=0; i < r_width * r_height ; i++ )
-    {
-        null_pixels[ i ] = rgbamap;
-    }
+    null_pixel = getPixelFor_SDLColor( &colour_black );
 
     // Done
     cout << "Init complete!" << endl;
@@ -113,6 +106,16 @@ void Window::drawSurface( SDL_Surface* surface, const SDL_Rect& dstrect )
     memcpy ( pixels_direct + r_pitch * dstrect.y, pixelss, r_pitch * dstrect.h ); // WARNING! DIRECT MEMORY ACCESS
 }
 
+Uint32* Window::GetPixels( Uint32& pitch )
+{
+    if ( headlessMode )
+        return nullptr;
+
+    LockRTexture();
+    pitch = r_pitch_div_4;
+    return pixels_direct;
+}
+
 void Window::drawTexture( const shared_ptr< Texture >& texture, const SDL_Rect& dstrect )
 {
     if ( headlessMode )
@@ -127,12 +130,26 @@ void Window::drawTexture( const shared_ptr< Texture >& texture, const SDL_Rect&
         return;
     }
 
-    // TODO replace this naive implementation
-    for ( int y = 0; y < texture->GetHeight(); y++ )
+    // clip to screen once instead of for every pixel
+    int x_start = std::max( -dstrect.x, 0 );
+    int y_start = std::max( -dstrect.y, 0 );
+    int x_stop = std::min< int >( texture->GetWidth(),  r_width  - dstrect.x );
+    int y_stop = std::min< int >( texture->GetHeight(), r_height - dstrect.y );
+
+    LockRTexture();
+    for ( int y = y_start; y < y_stop; y++ )
     {
-        for ( int x = 0; x < texture->GetWidth(); x++ )
+        Uint32* row = pixels_direct + ( dstrect.y + y ) * r_pitch_div_4 + dstrect.x;
+        if ( !texture->IsTiled() )
         {
-            this->drawPixel( dstrect.x + x, dstrect.y + y, texture->GetPixelRaw( x, y ));
+            // rows of untiled textures are contiguous
+            const Uint32* src = texture->GetMipPixels( 0 ) + y * texture->GetMipStride( 0 );
+            std::copy( src + x_start, src + x_stop, row + x_start );
+            continue;
+        }
+        for ( int x = x_start; x < x_stop; x++ )
+        {
+            row[ x ] = texture->GetPixelRaw( x, y );
         }
     }
 }
@@ -149,10 +166,9 @@ void Window::drawPixel( int x, int y, const SDL_Color& color)
         return;
     }
 
-    int offset = y * r_width + x;
-
     // obtain fast write access to texture
     LockRTexture();
+    int offset = y * r_pitch_div_4 + x;
     pixels_direct[ offset ] = getPixelFor_SDLColor( &color );
 }
 
@@ -168,10 +184,9 @@ void Window::drawPixel( int x, int y, const Uint32& raw_pixel)
         return;
     }
 
-    int offset = y * r_width + x;
-
     // obtain fast write access to texture
     LockRTexture();
+    int offset = y * r_pitch_div_4 + x;
     pixels_direct[ offset ] = raw_pixel;
 }
 
@@ -277,10 +292,11 @@ void Window::updateWindow()
     timer.TickCall();
 }
 
-void Window::clearBuffers()
+void Window::clearBuffers( bool clear_pixels )
 {
     // Clears the render texture and pixel array
     // (no need to clear the window or renderer as it's not blending textures
+    // The pixel array may be left alone if every pixel gets drawn anyway.
 
     if ( headlessMode )
         return;
@@ -304,8 +320,11 @@ void Window::clearBuffers()
 
 
     // clear ptexture to black
-    LockRTexture();
-    memcpy ( pixels_direct, null_pixels.get(), r_pitch * r_height ); // WARNING! DIRECT MEMORY ACCESS
+    if ( clear_pixels )
+    {
+        LockRTexture();
+        std::fill( pixels_direct, pixels_direct + r_pitch_div_4 * r_height, null_pixel ); // WARNING! DIRECT MEMORY ACCESS
+    }
 }
 
 void Window::updateTitleWithFPS( int updateInterval )
@@ -22,6 +22,9 @@ class Window
         unsigned int Getwidth() { return r_width; }
         unsigned int Getheight() { return r_height; }
         SDL_Surface* GetSurface() { return SDL_GetWindowSurface( w_window ); }
+        // pixels of the render texture for direct writes until the next updateWindow.
+        // Rows are pitch pixels apart. Returns nullptr in headless mode.
+        Uint32* GetPixels( Uint32& pitch );
 
         // Window functions
         void updateTitleWithFPS( int updateInterval ); // interval in seconds
@@ -37,7 +40,7 @@ class Window
         void reserveAddLines( Uint64 amount ); // reserves specified amount of lines (in addition to current reservation)
         void drawLine( SDL_Point p1, SDL_Point p2, const SDL_Color& color );
         void updateWindow();
-        void clearBuffers();
+        void clearBuffers( bool clear_pixels = true );
 
     protected:
 
@@ -58,7 +61,7 @@ class Window
 
         // Pixel access pointers
         Uint32 *pixels_direct = nullptr;
-        unique_ptr< Uint32[] >null_pixels = nullptr;
+        Uint32 null_pixel = 0;
 
         // Line vectors
         std::vector< SDL_Point > line_points;